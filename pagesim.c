@@ -4,11 +4,18 @@
    Description: Simulation of common page replacement algorithms used by
    operating systems to manage memory usage
  */
+#define _FILE_OFFSET_BITS 64 // off_t positions in out of core traces
 #include <stdio.h>
+#include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
+#include <strings.h>
+#include <limits.h>
+#include <math.h>
 #include <unistd.h>
 #include <time.h>
+#include <sys/types.h>
+#include <sys/wait.h>
 #include <sys/queue.h>
 #include "pagesim.h"
 
@@ -18,29 +25,102 @@
 int num_frames = 10; // Number of avaliable pages in page tables
 int page_ref_upper_bound = 12; // Largest page reference
 int max_page_calls = 1000; // Max number of page refs to test
+int refs_limited = 0; // 1 if max_page_calls was given and also caps a trace
+const char *trace_file = NULL; // Trace to read page refs from, NULL generates random refs
+int external_chunk = 0; // Refs per chunk of an out of core trace, 0 loads the trace into memory
 
 int debug = 0; // Debug bool, 1 shows verbose output
 int printrefs = 0; // Print refs bool, 1 shows output after each page ref
 
+int prefetch_mode = PREFETCH_NONE; // Prefetcher run between get_ref() and algorithms
+int prefetch_window = 4; // Pages prefetched per trigger, cluster size for fault-around
+int prefetch_priority = 0; // 0 inserts prefetched pages as next victims, 1 as if referenced
+int prefetching = 0; // 1 while prefetch_issue() inserts a page, algorithms skip demand fault bookkeeping
+
+int tlb_enabled = 0; // TLB bool, 1 simulates a TLB in front of every page table
+int tlb_l1_entries[3] = {64, 32, 4}; // First level TLB entries for 4K, 2M and 1G translations
+int tlb_l1_ways[3] = {4, 4, 4}; // First level TLB associativity for 4K, 2M and 1G translations
+int tlb_l2_entries = 1536; // Unified second level TLB entries
+int tlb_l2_ways = 12; // Unified second level TLB associativity
+int hugepages = HUGEPAGES_NONE; // Huge page mode
+int thp_threshold = 256; // Resident base pages in a 2M region before it is promoted
+
+int ws_window = 100; // Working set window in refs of virtual time, for WS and WSCLOCK
+int pff_threshold = 20; // Refs of virtual time between faults below which PFF grows a resident set
+double lecar_rate = 0.45; // LECAR learning rate, how far one regret moves expert weights
+
+int sample_interval = 0; // Refs per interval for sampled simulation, 0 simulates every ref
+int sample_clusters = 8; // Number of interval clusters, each simulated by one representative
+int sample_warmup = -1; // Refs before a representative interval replayed to warm up state, -1 for one interval
+int sample_check = 0; // Sample check bool, 1 also runs the full simulation to report sampling error
+int sample_dims = 15; // Random projection dimensions of interval signatures
+
+const char *checkpoint_file = NULL; // Checkpoint written every checkpoint_every refs, NULL disables checkpoints
+int checkpoint_every = 10000; // Refs between checkpoints
+const char *resume_file = NULL; // Checkpoint to resume from, NULL starts from the first ref
+int *fork_frames = NULL; // Frame counts of what-if continuations from resume_file
+int num_forks = 0; // Number of what-if continuations, 0 continues with the checkpoint's frames
+
+int partition_mode = PARTITION_NONE; // How frames are split into partitions
+int num_partitions = 0; // Number of sets or tenants
+int *tenant_soft = NULL; // Frames guaranteed to each tenant
+int *tenant_hard = NULL; // Most frames each tenant may hold
+int partition_jobs = 0; // Worker processes simulating sets, 0 for one per online CPU
+
+const char *metrics_file = NULL; // Windowed metrics output, "-" for stdout, NULL disables metrics
+int metrics_every = 1000; // Refs per metrics window
+int metrics_format = METRICS_CSV; // Metrics output format
+
+int analyze_epoch = 10000; // Refs per epoch for working set sizes in analyze mode
+double analyze_rate = 1.0; // Fraction of pages analyze mode tracks reuse for, by page hash
+int analyze_topk = 32; // Pages Space-Saving monitors for hot page skew
+
+int zswap_enabled = 0; // Compressed pool bool, 1 compresses victims before they go to swap
+long zswap_capacity = 1048576; // Compressed pool size in bytes
+int zswap_writeback = 1; // 1 writes LRU pool pages to swap when full, 0 rejects new pages instead
+float zswap_ratio_min = 1.5; // Lower bound of compression ratios drawn for pages the trace doesn't give
+float zswap_ratio_max = 4.0; // Upper bound of compression ratios drawn for pages the trace doesn't give
+double zswap_compress_us = 10.0; // CPU time to compress a page
+double zswap_decompress_us = 3.0; // CPU time to decompress a page
+double swap_read_us = 100.0; // Time to read a page from swap
+double swap_write_us = 50.0; // Time to write a page to swap
+
 /**
  * Array of algorithm functions that can be enabled
  */
-Algorithm algos[7] = { {"OPTIMAL", &OPTIMAL, 0, NULL},
-                       {"RANDOM", &RANDOM, 0, NULL},
-                       {"FIFO", &FIFO, 0, NULL},
-                       {"LRU", &LRU, 0, NULL},
-                       {"CLOCK", &CLOCK, 0, NULL},
-                       {"NFU", &NFU, 0, NULL},
-                       {"AGING", &AGING, 0, NULL} };
+Algorithm algos[11] = { {"OPTIMAL", &OPTIMAL, 0, NULL},
+                        {"RANDOM", &RANDOM, 0, NULL},
+                        {"FIFO", &FIFO, 0, NULL},
+                        {"LRU", &LRU, 0, NULL},
+                        {"CLOCK", &CLOCK, 0, NULL},
+                        {"NFU", &NFU, 0, NULL},
+                        {"AGING", &AGING, 0, NULL},
+                        {"WS", &WS, 0, NULL},
+                        {"WSCLOCK", &WSCLOCK, 0, NULL},
+                        {"PFF", &PFF, 0, NULL},
+                        {"LECAR", &LECAR, 0, NULL} };
 
 /**
  * Runtime variables, don't touch
  */
 int counter = 0; // "Time" as number of loops calling page_refs 0...num_refs (used as i in for loop)
 int last_page_ref = -1; // Last ref
+int last_pid = 0; // Process making last ref
+int num_procs = 1; // Number of processes making refs, pids are 0...num_procs-1
+int *vtime; // Virtual time per process, number of refs it has made
 size_t num_algos = 0; // Number of algorithms in algos, calculated in init()
 int *optimum_find_test;
 int num_refs = 0; // Number of page refs in page_refs list
+Page_Ref *ref_cursor = NULL; // Next page ref get_ref() returns, also where OPTIMAL's look-ahead starts
+Prefetcher prefetcher; // Stream detection state shared by all algorithms
+float *page_ratios; // Compression ratio per page, 0 until first needed
+pid_t checkpoint_pid = 0; // Background checkpoint writer, 0 if none running
+unsigned long long rand_state = 0; // next_rand() state, saved in checkpoints
+unsigned long long trace_hash = 0; // hash_ref() checksum of every ref, checkpoints only resume on the same refs
+Metrics metrics; // Windowed metrics stream
+External_Trace external; // Out of core trace, refs is NULL unless external_chunk is set
+Partition *partitions = NULL; // Sets or tenant partitions, NULL if memory isn't partitioned
+int partition_job = -1; // Worker simulating sets p % partition_jobs == partition_job, -1 simulates every partition
 
 /**
  * int main(int argc, char *argv[])
@@ -52,8 +132,41 @@ int num_refs = 0; // Number of page refs in page_refs list
  */
 int main ( int argc, char *argv[] )
 {
-        init();
-        if ( !(argc >= 3 && argc <= 5) )
+        int i, nargs = 1, named = 0, status = 0;
+        for (i = 1; i < argc; ++i)
+        { /* pull out --name=value options, leave positional args in order */
+                if(strncmp(argv[i], "--", 2) == 0)
+                {
+                        if(parse_option(argv[i]) != 0)
+                        {
+                                printf( "%s option is invalid\n", argv[i]);
+                                print_help(argv[0]);
+                                return 1;
+                        }
+                }
+                else
+                {
+                        argv[nargs++] = argv[i];
+                }
+        }
+        argc = nargs;
+        if(num_forks > 0 && resume_file == NULL)
+        {
+                printf( "--fork continues from a checkpoint, it needs --resume\n");
+                return 1;
+        }
+        if(sample_interval > 0 && metrics_file != NULL)
+        {
+                printf( "--sample skips most windows, it can't be used with --metrics\n");
+                return 1;
+        }
+        if ( argc >= 2 && (strcmp(argv[1], "analyze") == 0 || strcmp(argv[1], "ANALYZE") == 0) )
+        { /* characterize refs instead of simulating algorithms */
+                if(trace_file == NULL)
+                        gen_page_refs();
+                status = analyze_trace();
+        }
+        else if ( !(argc >= 3 && argc <= 5) )
         { /* argc should be 3-5 for correct execution */
                 print_help(argv[0]);
         }
@@ -87,6 +200,17 @@ int main ( int argc, char *argv[] )
                                 printf( "Debug must be 1 or 0, ignoring\n");
                         }
                 }
+                if(init() != 0)
+                        return 1;
+                for (i = 0; i < num_algos; i++)
+                { /* a full algorithm name selects just that algorithm */
+                        if(strcasecmp(argv[1], algos[i].label) == 0)
+                        {
+                                algos[i].selected = 1;
+                                named = 1;
+                        }
+                }
+                if(named == 0)
                 switch(argv[1][0])
                 {
                 case 'L':
@@ -101,9 +225,7 @@ int main ( int argc, char *argv[] )
                 case 'a':
                 case 'T':
                 case 't':
-                        printrefs = 1;
                         num_refs = -1;
-                        size_t i = 0;
                         for (i = 0; i < num_algos; i++)
                         {
                                 algos[i].selected = 1;
@@ -112,12 +234,25 @@ int main ( int argc, char *argv[] )
                 default:
                         printf( "%s algorithm is invalid choice or not yet implemented\n", argv[1]);
                         print_help(argv[0]);
+                        cleanup();
                         return 1;
                 }
-                event_loop();
+                if(sample_interval > 0 && external.refs != NULL)
+                {
+                        printf( "--sample needs the refs in memory, it can't be used with --external\n");
+                        status = 1;
+                }
+                else if(sample_interval > 0)
+                        status = sample_loop();
+                else if(resume_file != NULL)
+                        status = resume_loop();
+                else if(partition_mode == PARTITION_SETS && partition_jobs > 1)
+                        status = partition_loop();
+                else
+                        status = event_loop();
         }
         cleanup();
-        return 0;
+        return status;
 }
 
 /**
@@ -125,11 +260,30 @@ int main ( int argc, char *argv[] )
  *
  * Initialize lists and variables
  *
- * @return 0
+ * @return {int} 0, or 1 if page refs couldn't be loaded
  */
 int init()
 {
-        gen_page_refs();
+        Page_Ref *page;
+        if(trace_file != NULL && external_chunk > 0)
+        {
+                if(external_load(trace_file) != 0)
+                        return 1;
+        }
+        else if(trace_file != NULL)
+        {
+                if(load_page_refs(trace_file) != 0)
+                        return 1;
+        }
+        else
+        {
+                gen_page_refs();
+        }
+        ref_cursor = page_refs.lh_first;
+        for (page = page_refs.lh_first; page != NULL; page = page->pages.le_next)
+                trace_hash = hash_ref(trace_hash, page->page_num, page->ratio, page->pid);
+        page_ratios = calloc(page_ref_upper_bound, sizeof(float));
+        vtime = calloc(num_procs, sizeof(int));
         // Calculate number of algos
         num_algos = sizeof(algos)/sizeof(Algorithm);
         size_t i = 0;
@@ -137,215 +291,3549 @@ int init()
         {
                 algos[i].data = create_algo_data_store();
         }
+        prefetcher.last_ref = -1;
+        prefetcher.stride = 0;
+        prefetcher.run = 0;
+        prefetcher.num_candidates = 0;
+        prefetcher.candidates = malloc(sizeof(int)*(prefetch_window > 0 ? prefetch_window : 1));
+        if(metrics_file != NULL && metrics_open() != 0)
+                return 1;
+        if(partition_mode != PARTITION_NONE && create_partitions() != 0)
+                return 1;
+        return 0;
+}
+
+/**
+ * int create_partitions()
+ *
+ * Split the frames into sets of near equal size, or give each tenant its
+ * soft quota with the rest left in a pool to borrow from, and create page
+ * tables for every algorithm in every partition
+ *
+ * @return {int} 0, or 1 if the partitions don't fit or the run can't be partitioned
+ */
+int create_partitions()
+{
+        int p, frames = num_frames, quota = 0;
+        size_t i = 0;
+        if(tlb_enabled || zswap_enabled || sample_interval > 0 || external.refs != NULL
+           || checkpoint_file != NULL || resume_file != NULL || metrics.out != NULL)
+        {
+                printf( "--sets and --tenants can't be combined with TLB, huge pages, zswap, sampling, --external, checkpoints or metrics\n");
+                return 1;
+        }
+        for (p = 0; p < num_partitions; ++p)
+                quota += partition_mode == PARTITION_SETS ? 1 : tenant_soft[p];
+        if(quota > num_frames)
+        {
+                printf( "Partitions need %d frames, only %d in memory\n", quota, num_frames);
+                return 1;
+        }
+        if(partition_mode == PARTITION_TENANTS)
+                partition_jobs = 1; // Tenants borrow from each other, simulate them together
+        else if(partition_jobs == 0)
+                partition_jobs = (int)sysconf(_SC_NPROCESSORS_ONLN);
+        if(partition_jobs > num_partitions)
+                partition_jobs = num_partitions;
+        partitions = malloc(sizeof(Partition)*num_partitions);
+        for (p = 0; p < num_partitions; ++p)
+        {
+                if(partition_mode == PARTITION_SETS)
+                { // Spread the remainder over the first sets
+                        partitions[p].soft = frames / num_partitions + (p < frames % num_partitions);
+                        partitions[p].hard = partitions[p].soft;
+                }
+                else
+                {
+                        partitions[p].soft = tenant_soft[p];
+                        partitions[p].hard = tenant_hard[p] < frames ? tenant_hard[p] : frames;
+                }
+                partitions[p].refs = 0;
+                partitions[p].synced = 0;
+                partitions[p].rand_state = hash64(rand_state + p); // Same draws whichever worker simulates it
+                partitions[p].data = malloc(sizeof(Algorithm_Data*)*num_algos);
+                partitions[p].frames = malloc(sizeof(int)*num_algos);
+                partitions[p].borrowed = calloc(num_algos, sizeof(int));
+                partitions[p].reclaimed = calloc(num_algos, sizeof(int));
+                num_frames = partitions[p].soft;
+                for (i = 0; i < num_algos; ++i)
+                {
+                        partitions[p].data[i] = create_algo_data_store();
+                        partitions[p].frames[i] = num_frames;
+                }
+        }
+        num_frames = frames;
+        return 0;
+}
+
+/**
+ * int parse_option(const char *arg)
+ *
+ * Parse a --name=value commandline option into configuration variables
+ *
+ * @param arg {const char*} option as given on the commandline
+ *
+ * @return {int} 0 if option was understood, 1 otherwise
+ */
+int parse_option(const char *arg)
+{
+        const char *value = strchr(arg, '=');
+        size_t len = value == NULL ? strlen(arg) : (size_t)(value - arg);
+        value = value == NULL ? "" : value + 1;
+#define OPTION_IS(name) (strlen(name) == len && strncmp(arg, name, len) == 0)
+        if(OPTION_IS("--prefetch"))
+        {
+                if(strcmp(value, "none") == 0)
+                        prefetch_mode = PREFETCH_NONE;
+                else if(strcmp(value, "seq") == 0)
+                        prefetch_mode = PREFETCH_SEQ;
+                else if(strcmp(value, "stride") == 0)
+                        prefetch_mode = PREFETCH_STRIDE;
+                else if(strcmp(value, "cluster") == 0)
+                        prefetch_mode = PREFETCH_CLUSTER;
+                else
+                        return 1;
+        }
+        else if(OPTION_IS("--prefetch-window"))
+        {
+                prefetch_window = atoi(value);
+                if(prefetch_window < 1)
+                        return 1;
+        }
+        else if(OPTION_IS("--prefetch-priority"))
+        {
+                if(strcmp(value, "low") == 0)
+                        prefetch_priority = 0;
+                else if(strcmp(value, "high") == 0)
+                        prefetch_priority = 1;
+                else
+                        return 1;
+        }
+        else if(OPTION_IS("--tlb"))
+        {
+                if(*value != '\0' && strcmp(value, "1") != 0)
+                        return 1;
+                tlb_enabled = 1;
+        }
+        else if(OPTION_IS("--tlb-l1") || OPTION_IS("--tlb-l1-2m") || OPTION_IS("--tlb-l1-1g") || OPTION_IS("--tlb-l2"))
+        {
+                int entries, ways;
+                if(sscanf(value, "%d:%d", &entries, &ways) != 2 || entries < 1 || ways < 1 || entries % ways != 0)
+                        return 1;
+                if(OPTION_IS("--tlb-l2"))
+                {
+                        tlb_l2_entries = entries;
+                        tlb_l2_ways = ways;
+                }
+                else
+                {
+                        int size = OPTION_IS("--tlb-l1") ? PAGE_4K : OPTION_IS("--tlb-l1-2m") ? PAGE_2M : PAGE_1G;
+                        tlb_l1_entries[size] = entries;
+                        tlb_l1_ways[size] = ways;
+                }
+                tlb_enabled = 1;
+        }
+        else if(OPTION_IS("--hugepages"))
+        {
+                if(strcmp(value, "none") == 0)
+                        hugepages = HUGEPAGES_NONE;
+                else if(strcmp(value, "thp") == 0)
+                        hugepages = HUGEPAGES_THP;
+                else if(strcmp(value, "2m") == 0)
+                        hugepages = HUGEPAGES_2M;
+                else if(strcmp(value, "1g") == 0)
+                        hugepages = HUGEPAGES_1G;
+                else
+                        return 1;
+                tlb_enabled = 1;
+        }
+        else if(OPTION_IS("--thp-threshold"))
+        {
+                thp_threshold = atoi(value);
+                if(thp_threshold < 1 || thp_threshold > 512)
+                        return 1;
+        }
+        else if(OPTION_IS("--pages"))
+        {
+                page_ref_upper_bound = atoi(value);
+                if(page_ref_upper_bound < 1)
+                        return 1;
+        }
+        else if(OPTION_IS("--refs"))
+        {
+                max_page_calls = atoi(value);
+                if(max_page_calls < 1)
+                        return 1;
+                refs_limited = 1;
+        }
+        else if(OPTION_IS("--ws-window"))
+        {
+                ws_window = atoi(value);
+                if(ws_window < 1)
+                        return 1;
+        }
+        else if(OPTION_IS("--pff-threshold"))
+        {
+                pff_threshold = atoi(value);
+                if(pff_threshold < 1)
+                        return 1;
+        }
+        else if(OPTION_IS("--lecar-rate"))
+        {
+                lecar_rate = atof(value);
+                if(lecar_rate <= 0)
+                        return 1;
+        }
+        else if(OPTION_IS("--sample"))
+        {
+                sample_interval = atoi(value);
+                if(sample_interval < 1)
+                        return 1;
+        }
+        else if(OPTION_IS("--sample-clusters"))
+        {
+                sample_clusters = atoi(value);
+                if(sample_clusters < 1)
+                        return 1;
+        }
+        else if(OPTION_IS("--sample-warmup"))
+        {
+                sample_warmup = atoi(value);
+                if(*value == '\0' || sample_warmup < 0)
+                        return 1;
+        }
+        else if(OPTION_IS("--sample-check"))
+        {
+                if(*value != '\0' && strcmp(value, "1") != 0)
+                        return 1;
+                sample_check = 1;
+        }
+        else if(OPTION_IS("--sets"))
+        {
+                num_partitions = atoi(value);
+                if(num_partitions < 1)
+                        return 1;
+                partition_mode = PARTITION_SETS;
+        }
+        else if(OPTION_IS("--tenants"))
+        {
+                char *end;
+                free(tenant_soft);
+                free(tenant_hard);
+                tenant_soft = malloc(sizeof(int)*(strlen(value) / 2 + 1));
+                tenant_hard = malloc(sizeof(int)*(strlen(value) / 2 + 1));
+                num_partitions = 0;
+                do
+                { // soft[:hard], hard defaults to soft
+                        tenant_soft[num_partitions] = (int)strtol(value, &end, 10);
+                        tenant_hard[num_partitions] = tenant_soft[num_partitions];
+                        if(end != value && *end == ':')
+                        {
+                                value = end + 1;
+                                tenant_hard[num_partitions] = (int)strtol(value, &end, 10);
+                        }
+                        if(end == value || tenant_soft[num_partitions] < 1 || tenant_hard[num_partitions] < tenant_soft[num_partitions]
+                           || (*end != ',' && *end != '\0'))
+                                return 1;
+                        num_partitions++;
+                        value = end + 1;
+                } while(*end == ',');
+                partition_mode = PARTITION_TENANTS;
+        }
+        else if(OPTION_IS("--partition-jobs"))
+        {
+                partition_jobs = atoi(value);
+                if(*value == '\0' || partition_jobs < 0)
+                        return 1;
+        }
+        else if(OPTION_IS("--external"))
+        {
+                external_chunk = *value == '\0' ? 65536 : atoi(value);
+                if(external_chunk < 1)
+                        return 1;
+        }
+        else if(OPTION_IS("--metrics"))
+        {
+                if(*value == '\0')
+                        return 1;
+                metrics_file = value;
+        }
+        else if(OPTION_IS("--metrics-window"))
+        {
+                metrics_every = atoi(value);
+                if(metrics_every < 1)
+                        return 1;
+        }
+        else if(OPTION_IS("--metrics-format"))
+        {
+                if(strcmp(value, "csv") == 0)
+                        metrics_format = METRICS_CSV;
+                else if(strcmp(value, "bin") == 0)
+                        metrics_format = METRICS_BIN;
+                else
+                        return 1;
+        }
+        else if(OPTION_IS("--checkpoint"))
+        {
+                if(*value == '\0')
+                        return 1;
+                checkpoint_file = value;
+        }
+        else if(OPTION_IS("--checkpoint-every"))
+        {
+                checkpoint_every = atoi(value);
+                if(checkpoint_every < 1)
+                        return 1;
+        }
+        else if(OPTION_IS("--resume"))
+        {
+                if(*value == '\0')
+                        return 1;
+                resume_file = value;
+        }
+        else if(OPTION_IS("--fork"))
+        {
+                char *end;
+                free(fork_frames);
+                fork_frames = malloc(sizeof(int)*(strlen(value) / 2 + 1));
+                num_forks = 0;
+                do
+                {
+                        fork_frames[num_forks] = (int)strtol(value, &end, 10);
+                        if(end == value || fork_frames[num_forks++] < 1 || (*end != ',' && *end != '\0'))
+                                return 1;
+                        value = end + 1;
+                } while(*end == ',');
+        }
+        else if(OPTION_IS("--analyze-epoch"))
+        {
+                analyze_epoch = atoi(value);
+                if(analyze_epoch < 1)
+                        return 1;
+        }
+        else if(OPTION_IS("--analyze-rate"))
+        {
+                analyze_rate = atof(value);
+                if(analyze_rate <= 0 || analyze_rate > 1)
+                        return 1;
+        }
+        else if(OPTION_IS("--analyze-topk"))
+        {
+                analyze_topk = atoi(value);
+                if(analyze_topk < 1)
+                        return 1;
+        }
+        else if(OPTION_IS("--trace"))
+        {
+                if(*value == '\0')
+                        return 1;
+                trace_file = value;
+        }
+        else if(OPTION_IS("--zswap"))
+        {
+                zswap_capacity = atol(value);
+                if(*value == '\0' || zswap_capacity < 0)
+                        return 1;
+                zswap_enabled = 1;
+        }
+        else if(OPTION_IS("--zswap-writeback"))
+        {
+                if(strcmp(value, "lru") == 0)
+                        zswap_writeback = 1;
+                else if(strcmp(value, "none") == 0)
+                        zswap_writeback = 0;
+                else
+                        return 1;
+        }
+        else if(OPTION_IS("--zswap-ratio"))
+        {
+                if(sscanf(value, "%f:%f", &zswap_ratio_min, &zswap_ratio_max) != 2
+                   || zswap_ratio_min <= 0 || zswap_ratio_max < zswap_ratio_min)
+                        return 1;
+        }
+        else if(OPTION_IS("--zswap-costs"))
+        {
+                if(sscanf(value, "%lf:%lf", &zswap_compress_us, &zswap_decompress_us) != 2
+                   || zswap_compress_us < 0 || zswap_decompress_us < 0)
+                        return 1;
+        }
+        else if(OPTION_IS("--swap-costs"))
+        {
+                if(sscanf(value, "%lf:%lf", &swap_read_us, &swap_write_us) != 2
+                   || swap_read_us < 0 || swap_write_us < 0)
+                        return 1;
+        }
+        else
+        {
+                return 1;
+        }
+#undef OPTION_IS
         return 0;
 }
 
 /**
- * void gen_page_refs()
+ * void gen_page_refs()
+ *
+ * Generate all page refs to use in tests
+ *
+ * @return 0
+ */
+void gen_page_refs()
+{
+        num_refs = 0;
+        LIST_INIT(&page_refs);
+        Page_Ref *page = gen_ref(), *next;
+        LIST_INSERT_HEAD(&page_refs, page, pages);
+        while(num_refs < max_page_calls)
+        { // generate a page ref up too  max_page_calls and add to list
+                next = gen_ref(); // LIST_INSERT_AFTER evaluates elm more than once
+                LIST_INSERT_AFTER(page, next, pages);
+                page = next;
+                num_refs++;
+        }
+        // we need look-ahead for Optimal algorithm
+        int all_found = 0;
+        optimum_find_test = (int*)malloc(page_ref_upper_bound*sizeof(int));
+        size_t i;
+        for(i = 0; i < page_ref_upper_bound; ++i)
+        { // generate new refs until one of each have been added to list
+                optimum_find_test[i] = -1;
+        }
+        while(all_found == 0)
+        { // generate new refs until one of each have been added to list
+                next = gen_ref();
+                LIST_INSERT_AFTER(page, next, pages);
+                page = next;
+                optimum_find_test[page->page_num] = 1;
+                all_found = 1;
+                for(i = 0; i < page_ref_upper_bound; ++i)
+                { // see if we've got them all yet
+                        if(optimum_find_test[i] == -1)
+                        {
+                                all_found = 0;
+                                break;
+                        }
+                }
+                num_refs++;
+        }
+        return;
+}
+
+/**
+ * int load_page_refs(const char *path)
+ *
+ * Read all page refs to use in tests from a trace file. Each line holds a
+ * page number, optionally the page's compression ratio at that ref (0 if
+ * unknown) and the process making the ref. Lines starting with # are skipped.
+ *
+ * @param path {const char*} trace file
+ *
+ * @return {int} 0, or 1 if trace couldn't be read
+ */
+int load_page_refs(const char *path)
+{
+        FILE *trace = fopen(path, "r");
+        char line[256];
+        Page_Ref *page = NULL, *last = NULL;
+        if(trace == NULL)
+        {
+                printf( "Could not open trace %s\n", path);
+                return 1;
+        }
+        num_refs = 0;
+        page_ref_upper_bound = 1;
+        LIST_INIT(&page_refs);
+        while(fgets(line, sizeof(line), trace) != NULL && (!refs_limited || num_refs < max_page_calls))
+        {
+                page = malloc(sizeof(Page_Ref));
+                page->ratio = 0;
+                page->pid = 0;
+                if(line[0] == '#' || sscanf(line, "%d %f %d", &page->page_num, &page->ratio, &page->pid) < 1
+                   || page->page_num < 0 || page->pid < 0)
+                {
+                        free(page);
+                        continue;
+                }
+                if(page->page_num >= page_ref_upper_bound)
+                        page_ref_upper_bound = page->page_num + 1;
+                if(page->pid >= num_procs)
+                        num_procs = page->pid + 1;
+                if(last == NULL)
+                        LIST_INSERT_HEAD(&page_refs, page, pages);
+                else
+                        LIST_INSERT_AFTER(last, page, pages);
+                last = page;
+                num_refs++;
+        }
+        fclose(trace);
+        if(num_refs == 0)
+        {
+                printf( "Trace %s has no page refs\n", path);
+                return 1;
+        }
+        max_page_calls = num_refs;
+        optimum_find_test = (int*)malloc(page_ref_upper_bound*sizeof(int));
+        return 0;
+}
+
+/**
+ * int external_load(const char *path)
+ *
+ * Prepare a trace for out of core runs. A forward pass spills its refs to
+ * a temporary file of fixed size records. A backward pass reads them a
+ * chunk at a time from the last chunk to the first, finds each ref's
+ * next-use position from the last position seen per page, and spills the
+ * positions chunk by chunk, so they are stored last chunk first. The
+ * last position seen per page ends up as its first use, the next use of
+ * every page before the first ref. Only a chunk of refs and positions is
+ * ever in memory while simulating, plus that next-use position per page.
+ * Positions and offsets are 64 bit.
+ *
+ * @param path {const char*} trace file, same format as load_page_refs()
+ *
+ * @return {int} 0, or 1 if the trace couldn't be read or spilled
+ */
+int external_load(const char *path)
+{
+        FILE *trace = fopen(path, "r");
+        char line[256];
+        Trace_Record record;
+        int64_t c, j, n;
+        if(trace == NULL)
+        {
+                printf( "Could not open trace %s\n", path);
+                return 1;
+        }
+        external.refs = tmpfile();
+        external.uses = tmpfile();
+        if(external.refs == NULL || external.uses == NULL)
+        {
+                printf( "Could not create temporary files for trace %s\n", path);
+                fclose(trace);
+                return 1;
+        }
+        external.num_refs = 0;
+        page_ref_upper_bound = 1;
+        while(fgets(line, sizeof(line), trace) != NULL && (!refs_limited || external.num_refs < max_page_calls))
+        { // Forward pass, spill refs
+                record.ratio = 0;
+                record.pid = 0;
+                if(line[0] == '#' || sscanf(line, "%d %f %d", &record.page_num, &record.ratio, &record.pid) < 1
+                   || record.page_num < 0 || record.pid < 0)
+                        continue;
+                if(record.page_num >= page_ref_upper_bound)
+                        page_ref_upper_bound = record.page_num + 1;
+                if(record.pid >= num_procs)
+                        num_procs = record.pid + 1;
+                fwrite(&record, sizeof(Trace_Record), 1, external.refs);
+                trace_hash = hash_ref(trace_hash, record.page_num, record.ratio, record.pid);
+                external.num_refs++;
+        }
+        fclose(trace);
+        if(external.num_refs == 0)
+        {
+                printf( "Trace %s has no page refs\n", path);
+                return 1;
+        }
+        if(external.num_refs > INT_MAX)
+        { // Positions are 64 bit, but the simulation counts refs in an int
+                printf( "Trace %s has %lld refs, simulating the first %d\n", path, (long long)external.num_refs, INT_MAX);
+                external.num_refs = INT_MAX;
+        }
+        max_page_calls = (int)external.num_refs;
+        num_refs = max_page_calls;
+        external.chunk = external_chunk;
+        external.num_chunks = (external.num_refs + external.chunk - 1) / external.chunk;
+        external.ref_buf = malloc(sizeof(Trace_Record)*external.chunk);
+        external.use_buf = malloc(sizeof(int64_t)*external.chunk);
+        external.next_seen = malloc(sizeof(int64_t)*page_ref_upper_bound);
+        for (j = 0; j < page_ref_upper_bound; ++j)
+                external.next_seen[j] = INT64_MAX;
+        for (c = external.num_chunks - 1; c >= 0; --c)
+        { // Backward pass, spill next-use positions in reverse chunk order
+                n = c == external.num_chunks - 1 ? external.num_refs - c*external.chunk : external.chunk;
+                fseeko(external.refs, (off_t)c*external.chunk*sizeof(Trace_Record), SEEK_SET);
+                if(fread(external.ref_buf, sizeof(Trace_Record), n, external.refs) != (size_t)n)
+                        break;
+                for (j = n - 1; j >= 0; --j)
+                {
+                        external.use_buf[j] = external.next_seen[external.ref_buf[j].page_num];
+                        external.next_seen[external.ref_buf[j].page_num] = c*external.chunk + j;
+                }
+                fwrite(external.use_buf, sizeof(int64_t), n, external.uses);
+        }
+        if(c >= 0 || fflush(external.refs) != 0 || fflush(external.uses) != 0)
+        {
+                printf( "Could not spill trace %s to temporary files\n", path);
+                return 1;
+        }
+        external.loaded = -1;
+        external.pos = 0;
+        return 0;
+}
+
+/**
+ * int external_chunk_load(int64_t chunk)
+ *
+ * Read a chunk of an out of core trace's refs and their next-use
+ * positions. Positions were spilled last chunk first, after the short last
+ * chunk every chunk is full size, so a chunk's offset is computed directly.
+ *
+ * @param chunk {int64_t} chunk to load
+ *
+ * @return {int} refs in chunk, 0 if it couldn't be read
+ */
+int external_chunk_load(int64_t chunk)
+{
+        int64_t last = external.num_refs - (external.num_chunks - 1)*external.chunk,
+                n = chunk == external.num_chunks - 1 ? last : external.chunk;
+        off_t offset = chunk == external.num_chunks - 1 ? 0 : last + (off_t)(external.num_chunks - 2 - chunk)*external.chunk;
+        fseeko(external.refs, (off_t)chunk*external.chunk*sizeof(Trace_Record), SEEK_SET);
+        fseeko(external.uses, offset*(off_t)sizeof(int64_t), SEEK_SET);
+        if(fread(external.ref_buf, sizeof(Trace_Record), n, external.refs) != (size_t)n
+           || fread(external.use_buf, sizeof(int64_t), n, external.uses) != (size_t)n)
+                return 0;
+        external.loaded = chunk;
+        return (int)n;
+}
+
+/**
+ * int external_ref()
+ *
+ * Next ref of an out of core trace, loading its chunk when the last one
+ * runs out, and moving its page's next use on for OPTIMAL
+ *
+ * @return {int} page referenced
+ */
+int external_ref()
+{
+        Trace_Record *record;
+        int64_t chunk = external.pos / external.chunk;
+        if(external.pos >= external.num_refs || (chunk != external.loaded && external_chunk_load(chunk) == 0))
+        { // just in case
+                last_pid = 0;
+                return next_rand() % page_ref_upper_bound;
+        }
+        record = &external.ref_buf[external.pos % external.chunk];
+        if(record->ratio > 0)
+                page_ratios[record->page_num] = record->ratio;
+        last_pid = record->pid;
+        external.next_seen[record->page_num] = external.use_buf[external.pos % external.chunk];
+        external.pos++;
+        return record->page_num;
+}
+
+/**
+ * int external_seek(int64_t pos)
+ *
+ * Move an out of core trace to pos, as when resuming a checkpoint, and
+ * rebuild every page's next use by streaming the whole trace. A page
+ * referenced before pos is next used where its last ref there says, and
+ * that's never after its first ref from pos on, so keeping the earliest of
+ * the two covers pages seen before pos and pages first used after it.
+ *
+ * @param pos {int64_t} position of the next ref to return
+ *
+ * @return {int} 0, or 1 if the trace couldn't be read
+ */
+int external_seek(int64_t pos)
+{
+        int64_t chunk, j, n, *next;
+        for (j = 0; j < page_ref_upper_bound; ++j)
+                external.next_seen[j] = INT64_MAX;
+        for (chunk = 0; chunk < external.num_chunks; ++chunk)
+        {
+                if((n = external_chunk_load(chunk)) == 0)
+                        return 1;
+                for (j = 0; j < n; ++j)
+                {
+                        next = &external.next_seen[external.ref_buf[j].page_num];
+                        if(chunk*external.chunk + j < pos)
+                                *next = external.use_buf[j];
+                        else if(chunk*external.chunk + j < *next)
+                                *next = chunk*external.chunk + j;
+                }
+        }
+        external.pos = pos;
+        return 0;
+}
+
+/**
+ * Page_Ref* gen_ref()
+ *
+ * generate a random page ref within bounds
+ *
+ * @return {Page_Ref*}
+ */
+Page_Ref* gen_ref()
+{
+        Page_Ref *page = malloc(sizeof(Page_Ref));
+        page->page_num = next_rand() % page_ref_upper_bound;
+        page->ratio = 0;
+        page->pid = 0;
+        return page;
+}
+
+/**
+ * Algorithm_Data* create_algo_data_store(int num_frames)
+ *
+ * Creates an empty Algorithm_Data to init an Algorithm
+ *
+ * @return {Algorithm_Data*} empty Algorithm_Data struct for an Algorithm
+ */
+Algorithm_Data *create_algo_data_store()
+{
+        Algorithm_Data *data = malloc(sizeof(Algorithm_Data));
+        data->hits = 0;
+        data->misses = 0;
+        data->last_victim = NULL;
+        data->hand = NULL;
+        data->proc_extra = calloc(num_procs, sizeof(int));
+        data->resident = 0;
+        data->space_time = 0;
+        data->prefetches = 0;
+        data->prefetch_hits = 0;
+        data->prefetch_wasted = 0;
+        data->prefetch_unused = 0;
+        data->evictions = 0;
+        data->tlb = tlb_enabled ? create_tlb() : NULL;
+        data->zswap = zswap_enabled ? create_zswap() : NULL;
+        data->lecar = NULL;
+        /* Initialize Lists */
+        LIST_INIT(&(data->page_table));
+        LIST_INIT(&(data->victim_list));
+        /* Insert at the page_table. */
+        Frame *framep = create_empty_frame(0), *nextp;
+        LIST_INSERT_HEAD(&(data->page_table), framep, frames);
+        /* Build the rest of the list. */
+        size_t i = 0;
+        for (i = 1; i < num_frames; ++i)
+        { // LIST_INSERT_AFTER evaluates elm more than once, create frame first
+                nextp = create_empty_frame(i);
+                LIST_INSERT_AFTER(framep, nextp, frames);
+                framep = nextp;
+        }
+        return data;
+}
+
+/**
+ * void free_algo_data_store(Algorithm_Data *data)
+ *
+ * Frees an Algorithm_Data, its frames, victims and models
+ *
+ * @param data {Algorithm_Data*} data to free
+ */
+void free_algo_data_store(Algorithm_Data *data)
+{
+        Frame *framep;
+        /* Clean up memory, delete the lists */
+        while ((framep = data->page_table.lh_first) != NULL)
+        {
+                LIST_REMOVE(framep, frames);
+                free(framep);
+        }
+        while ((framep = data->victim_list.lh_first) != NULL)
+        {
+                LIST_REMOVE(framep, frames);
+                free(framep);
+        }
+        if(data->tlb != NULL)
+                free_tlb(data->tlb);
+        if(data->zswap != NULL)
+                free_zswap(data->zswap);
+        if(data->lecar != NULL)
+                free_lecar(data->lecar);
+        free(data->proc_extra);
+        free(data);
+}
+
+/**
+ * int reset_algos()
+ *
+ * Replace every algorithm's data with an empty store and forget prefetcher
+ * streams and process virtual time, as if no refs had been made
+ *
+ * @return 0
+ */
+int reset_algos()
+{
+        size_t i = 0;
+        for (i = 0; i < num_algos; ++i)
+        {
+                free_algo_data_store(algos[i].data);
+                algos[i].data = create_algo_data_store();
+        }
+        prefetcher.last_ref = -1;
+        prefetcher.stride = 0;
+        prefetcher.run = 0;
+        prefetcher.num_candidates = 0;
+        memset(vtime, 0, sizeof(int)*num_procs);
+        return 0;
+}
+
+/**
+ * Frame* create_empty_frame(int num_frames)
+ *
+ * Creates an empty Frame for page table list
+ *
+ * @return {Frame*} empty Frame entry for page table list
+ */
+Frame* create_empty_frame(int index)
+{
+        Frame *framep = malloc(sizeof(Frame));
+        framep->index = index;
+        framep->page = -1;
+        framep->time = counter;
+        framep->extra = 0;
+        framep->prefetched = -1;
+        framep->pid = 0;
+        return framep;
+}
+
+/**
+ * int event_loop()
+ *
+ * page all selected algorithms with input ref
+ *
+ * @param page_ref {int} page to ref
+ *
+ * @return 0
+ */
+int event_loop()
+{
+        /* counter is 0, or where a resumed checkpoint left off */
+        if(metrics.out != NULL)
+                metrics_start();
+        while(counter < max_page_calls)
+        {
+                page(get_ref());
+                ++counter;
+                if(metrics.out != NULL && counter % metrics_every == 0)
+                        metrics_window();
+                if(checkpoint_file != NULL && counter % checkpoint_every == 0 && counter < max_page_calls)
+                        checkpoint();
+        }
+        if(metrics.out != NULL && counter > metrics.window_start)
+                metrics_window(); // Last partial window
+        if(checkpoint_file != NULL)
+                checkpoint_reap(1);
+        size_t i = 0;
+        if(partitions != NULL)
+                partition_totals();
+        else
+                for (i = 0; i < num_algos; i++)
+                        algos[i].data->prefetch_unused = count_prefetch_unused(algos[i].data);
+        for (i = 0; i < num_algos; i++)
+        {
+                if(algos[i].selected==1) {
+                        print_summary(algos[i]);
+                }
+        }
+        size_t best = num_algos, lecar = num_algos;
+        for (i = 0; i < num_algos; i++)
+        { // Find best fixed algorithm to compare adaptive LECAR against
+                if(algos[i].selected == 0 || algos[i].algo == &OPTIMAL)
+                        continue;
+                if(algos[i].algo == &LECAR)
+                        lecar = i;
+                else if(best == num_algos || algos[i].data->hits > algos[best].data->hits)
+                        best = i;
+        }
+        if(lecar < num_algos && best < num_algos)
+        {
+                printf("LECAR vs best fixed (%s): ", algos[best].label);
+                printf("%+d hits, ", algos[lecar].data->hits - algos[best].data->hits);
+                printf("Hit Ratio %+f\n", (double)(algos[lecar].data->hits - algos[best].data->hits)/(double)counter);
+        }
+        if(partitions != NULL)
+                print_partitions();
+        return 0;
+}
+
+/**
+ * int simulate_refs(int start, int warmup, int len)
+ *
+ * Page all selected algorithms with refs start...start+len-1, first
+ * replaying the warmup refs before start to fill page tables. Only refs
+ * from start on count towards hits and misses.
+ *
+ * @param start {int} position of first counted ref
+ * @param warmup {int} refs replayed before start, cut short at the first ref
+ * @param len {int} number of counted refs
+ *
+ * @return 0
+ */
+int simulate_refs(int start, int warmup, int len)
+{
+        size_t i = 0;
+        if(warmup > start)
+                warmup = start;
+        ref_cursor = page_refs.lh_first;
+        for (counter = 0; counter < start - warmup; ++counter)
+                ref_cursor = ref_cursor->pages.le_next;
+        while(counter < start)
+        {
+                page(get_ref());
+                ++counter;
+        }
+        for (i = 0; i < num_algos; i++)
+        {
+                algos[i].data->hits = 0;
+                algos[i].data->misses = 0;
+        }
+        while(counter < start + len)
+        {
+                page(get_ref());
+                ++counter;
+        }
+        return 0;
+}
+
+/**
+ * int sample_loop()
+ *
+ * Split the refs into intervals, cluster them by signature, and simulate
+ * only the interval closest to each cluster's centre from a fresh state
+ * after its warmup. Hit ratios are estimated as the representatives' hit
+ * ratios weighted by their clusters' share of refs.
+ *
+ * @return 0
+ */
+int sample_loop()
+{
+        int num_intervals = (max_page_calls + sample_interval - 1) / sample_interval,
+            k = sample_clusters < num_intervals ? sample_clusters : num_intervals,
+            warmup = sample_warmup < 0 ? sample_interval : sample_warmup,
+            simulated = 0, c, j, n, len;
+        int *cluster = malloc(sizeof(int)*num_intervals),
+            *rep = malloc(sizeof(int)*k);
+        double *sigs = malloc(sizeof(double)*num_intervals*sample_dims),
+               *best = malloc(sizeof(double)*k),
+               *weight = calloc(k, sizeof(double)),
+               *estimate = calloc(num_algos, sizeof(double)),
+               *centroid = malloc(sizeof(double)*sample_dims),
+               dist;
+        Page_Ref *page = page_refs.lh_first;
+        unsigned long long start_state = rand_state;
+        size_t i = 0;
+        /* Signatures of every interval */
+        for (n = 0; n < num_intervals; ++n)
+        {
+                len = n == num_intervals - 1 ? max_page_calls - n*sample_interval : sample_interval;
+                interval_signature(page, len, &sigs[n*sample_dims]);
+                for (j = 0; j < len; ++j)
+                        page = page->pages.le_next;
+        }
+        cluster_intervals(sigs, num_intervals, k, cluster);
+        /* Pick interval nearest each cluster's centre as its representative */
+        for (c = 0; c < k; ++c)
+        {
+                rep[c] = -1;
+                memset(centroid, 0, sizeof(double)*sample_dims);
+                for (n = 0, len = 0; n < num_intervals; ++n)
+                        if(cluster[n] == c)
+                        {
+                                for (j = 0; j < sample_dims; ++j)
+                                        centroid[j] += sigs[n*sample_dims + j];
+                                len++;
+                                weight[c] += n == num_intervals - 1 ? max_page_calls - n*sample_interval : sample_interval;
+                        }
+                for (n = 0; n < num_intervals; ++n)
+                {
+                        if(cluster[n] != c)
+                                continue;
+                        for (j = 0, dist = 0; j < sample_dims; ++j)
+                                dist += (sigs[n*sample_dims + j] - centroid[j]/len) * (sigs[n*sample_dims + j] - centroid[j]/len);
+                        if(rep[c] == -1 || dist < best[c])
+                        {
+                                rep[c] = n;
+                                best[c] = dist;
+                        }
+                }
+        }
+        /* Refuse if representatives and their warmups cost as much as a full run */
+        for (c = 0; c < k; ++c)
+                if(rep[c] != -1)
+                        simulated += (rep[c] == num_intervals - 1 ? max_page_calls - rep[c]*sample_interval : sample_interval)
+                                     + (warmup < rep[c]*sample_interval ? warmup : rep[c]*sample_interval);
+        if(simulated >= max_page_calls)
+        {
+                printf("Sampling would simulate %d of %d refs, no fewer than a full run; ", simulated, max_page_calls);
+                printf("use a longer --sample, fewer --sample-clusters or a shorter --sample-warmup\n");
+                k = 0;
+        }
+        /* Simulate representatives */
+        for (c = 0; c < k; ++c)
+        {
+                if(rep[c] == -1)
+                        continue; // Empty cluster
+                len = rep[c] == num_intervals - 1 ? max_page_calls - rep[c]*sample_interval : sample_interval;
+                reset_algos();
+                simulate_refs(rep[c]*sample_interval, warmup, len);
+                for (i = 0; i < num_algos; i++)
+                        if(algos[i].selected == 1)
+                                estimate[i] += weight[c] / max_page_calls *
+                                               (double)algos[i].data->hits/(double)(algos[i].data->hits+algos[i].data->misses);
+        }
+        if(k == 0)
+        {
+                free(cluster);
+                free(rep);
+                free(sigs);
+                free(best);
+                free(weight);
+                free(estimate);
+                free(centroid);
+                return 1;
+        }
+        printf("Sampled %d intervals of %d refs into %d clusters, ", num_intervals, sample_interval, k);
+        printf("simulated %d of %d refs (%f)\n", simulated, max_page_calls, (double)simulated/(double)max_page_calls);
+        if(sample_check == 1)
+        { // Full run to measure sampling error against, with the random draws a plain run would see
+                reset_algos();
+                rand_state = start_state;
+                simulate_refs(0, 0, max_page_calls);
+        }
+        for (i = 0; i < num_algos; i++)
+        {
+                if(algos[i].selected == 0)
+                        continue;
+                printf("%s Algorithm\n", algos[i].label);
+                printf("Frames in Mem: %d, ", num_frames);
+                printf("Estimated Hit Ratio: %f", estimate[i]);
+                if(sample_check == 1)
+                {
+                        dist = (double)algos[i].data->hits/(double)(algos[i].data->hits+algos[i].data->misses);
+                        printf(", Full Hit Ratio: %f, ", dist);
+                        printf("Error: %+f", estimate[i] - dist);
+                }
+                printf("\n");
+        }
+        free(cluster);
+        free(rep);
+        free(sigs);
+        free(best);
+        free(weight);
+        free(estimate);
+        free(centroid);
+        return 0;
+}
+
+/**
+ * int interval_signature(Page_Ref *start, int len, double *sig)
+ *
+ * Signature of an interval, its page frequency vector randomly projected
+ * down to sample_dims dimensions and normalised by interval length. Each
+ * page's projection is hashed from its number, so no matrix is stored.
+ *
+ * @param start {Page_Ref*} first ref of interval
+ * @param len {int} refs in interval
+ * @param sig {double*} sample_dims long signature to fill
+ *
+ * @return 0
+ */
+int interval_signature(Page_Ref *start, int len, double *sig)
+{
+        Page_Ref *page = start;
+        unsigned int hash;
+        int i, j;
+        memset(sig, 0, sizeof(double)*sample_dims);
+        for (i = 0; i < len && page != NULL; ++i, page = page->pages.le_next)
+        {
+                for (j = 0; j < sample_dims; ++j)
+                { // uniform [-1, 1] weight of page in dimension j
+                        hash = (unsigned int)page->page_num * 2654435761u ^ (unsigned int)(j + 1) * 40503u;
+                        hash ^= hash >> 15;
+                        hash *= 2246822519u;
+                        hash ^= hash >> 13;
+                        sig[j] += (double)hash / 2147483647.5 - 1.0;
+                }
+        }
+        for (j = 0; j < sample_dims; ++j)
+                sig[j] /= len;
+        return 0;
+}
+
+/**
+ * int cluster_intervals(double *sigs, int num_intervals, int k, int *cluster)
+ *
+ * Cluster interval signatures with k-means, seeded with evenly spaced
+ * intervals so runs are repeatable
+ *
+ * @param sigs {double*} num_intervals signatures of sample_dims each
+ * @param num_intervals {int} number of intervals
+ * @param k {int} number of clusters, at most num_intervals
+ * @param cluster {int*} cluster of each interval to fill
+ *
+ * @return {int} iterations until assignments settled
+ */
+int cluster_intervals(double *sigs, int num_intervals, int k, int *cluster)
+{
+        double *centroids = malloc(sizeof(double)*k*sample_dims),
+               dist, best;
+        int *sizes = malloc(sizeof(int)*k),
+            c, j, n, changed = 1, iter;
+        for (c = 0; c < k; ++c)
+                memcpy(&centroids[c*sample_dims], &sigs[(c*num_intervals/k)*sample_dims], sizeof(double)*sample_dims);
+        for (n = 0; n < num_intervals; ++n)
+                cluster[n] = -1;
+        for (iter = 0; changed && iter < 100; ++iter)
+        {
+                changed = 0;
+                for (n = 0; n < num_intervals; ++n)
+                { // Assign each interval to nearest centroid
+                        for (c = 0, best = -1; c < k; ++c)
+                        {
+                                for (j = 0, dist = 0; j < sample_dims; ++j)
+                                        dist += (sigs[n*sample_dims + j] - centroids[c*sample_dims + j]) *
+                                                (sigs[n*sample_dims + j] - centroids[c*sample_dims + j]);
+                                if(best < 0 || dist < best)
+                                {
+                                        best = dist;
+                                        if(cluster[n] != c)
+                                        {
+                                                cluster[n] = c;
+                                                changed = 1;
+                                        }
+                                }
+                        }
+                }
+                memset(sizes, 0, sizeof(int)*k);
+                for (n = 0; n < num_intervals; ++n)
+                        sizes[cluster[n]]++;
+                for (c = 0; c < k; ++c)
+                { // Move centroids to the mean of their intervals, empty clusters stay put
+                        if(sizes[c] == 0)
+                                continue;
+                        memset(&centroids[c*sample_dims], 0, sizeof(double)*sample_dims);
+                        for (n = 0; n < num_intervals; ++n)
+                                if(cluster[n] == c)
+                                        for (j = 0; j < sample_dims; ++j)
+                                                centroids[c*sample_dims + j] += sigs[n*sample_dims + j] / sizes[c];
+                }
+        }
+        free(centroids);
+        free(sizes);
+        return iter;
+}
+
+/**
+ * int checkpoint()
+ *
+ * Snapshot the simulation and write it to checkpoint_file without stalling.
+ * A forked child's copy-on-write memory is the snapshot, so the child writes
+ * it while the simulation carries on.
+ * A checkpoint is skipped if the last one is still being written.
+ *
+ * @return {int} 0, or 1 if skipped or written synchronously and failed
+ */
+int checkpoint()
+{
+        pid_t pid;
+        if(checkpoint_pid > 0 && checkpoint_reap(0) != 0)
+        {
+                if(debug) printf("Checkpoint at ref %d skipped, last one still writing\n", counter);
+                return 1;
+        }
+        fflush(stdout); // Child mustn't inherit unwritten output
+        pid = fork();
+        if(pid == 0)
+        { // Child holds the snapshot, write it and leave without running atexit or flushing stdio
+                _exit(write_checkpoint(checkpoint_file));
+        }
+        if(pid < 0)
+        { // Couldn't fork, write in the foreground
+                return write_checkpoint(checkpoint_file);
+        }
+        checkpoint_pid = pid;
+        if(debug) printf("Checkpoint at ref %d writing, pid %d\n", counter, (int)pid);
+        return 0;
+}
+
+/**
+ * int checkpoint_reap(int wait)
+ *
+ * Collect the background checkpoint writer if it has finished
+ *
+ * @param wait {int} 1 blocks until the writer finishes, 0 returns at once
+ *
+ * @return {int} 0 if no writer is left running, 1 if it is still writing
+ */
+int checkpoint_reap(int wait)
+{
+        int status;
+        pid_t pid;
+        if(checkpoint_pid <= 0)
+                return 0;
+        pid = waitpid(checkpoint_pid, &status, wait ? 0 : WNOHANG);
+        if(pid == 0)
+                return 1;
+        if(pid < 0 || !WIFEXITED(status) || WEXITSTATUS(status) != 0)
+                printf("Checkpoint %s could not be written\n", checkpoint_file);
+        checkpoint_pid = 0;
+        return 0;
+}
+
+/**
+ * int write_checkpoint(const char *path)
+ *
+ * Write the trace's ref count and checksum, the ref position, random number
+ * state, process and prefetcher state and every algorithm's state to path. Written to path.tmp then renamed, so a
+ * crash mid-write leaves the last good checkpoint.
+ *
+ * @param path {const char*} checkpoint file
+ *
+ * @return {int} 0, or 1 if it couldn't be written
+ */
+int write_checkpoint(const char *path)
+{
+        char *tmp = malloc(strlen(path) + 5);
+        int frames = num_frames, algo_count = num_algos, failed;
+        size_t i = 0;
+        FILE *f;
+        sprintf(tmp, "%s.tmp", path);
+        if((f = fopen(tmp, "wb")) == NULL)
+        {
+                free(tmp);
+                return 1;
+        }
+        fwrite("PGSIMCK3", 1, 8, f);
+        fwrite(&frames, sizeof(int), 1, f);
+        fwrite(&page_ref_upper_bound, sizeof(int), 1, f);
+        fwrite(&num_procs, sizeof(int), 1, f);
+        fwrite(&algo_count, sizeof(int), 1, f);
+        fwrite(&tlb_enabled, sizeof(int), 1, f);
+        fwrite(&zswap_enabled, sizeof(int), 1, f);
+        fwrite(&max_page_calls, sizeof(int), 1, f);
+        fwrite(&trace_hash, sizeof(unsigned long long), 1, f);
+        fwrite(&counter, sizeof(int), 1, f);
+        fwrite(&last_page_ref, sizeof(int), 1, f);
+        fwrite(&last_pid, sizeof(int), 1, f);
+        fwrite(&rand_state, sizeof(unsigned long long), 1, f);
+        fwrite(vtime, sizeof(int), num_procs, f);
+        fwrite(page_ratios, sizeof(float), page_ref_upper_bound, f);
+        fwrite(&prefetcher.last_ref, sizeof(int), 1, f);
+        fwrite(&prefetcher.stride, sizeof(int), 1, f);
+        fwrite(&prefetcher.run, sizeof(int), 1, f);
+        for (i = 0; i < num_algos; ++i)
+        {
+                fwrite(algos[i].label, 1, strlen(algos[i].label) + 1, f);
+                save_algo_data(f, algos[i].data);
+        }
+        failed = ferror(f);
+        if(fclose(f) != 0 || failed || rename(tmp, path) != 0)
+        {
+                remove(tmp);
+                free(tmp);
+                return 1;
+        }
+        free(tmp);
+        return 0;
+}
+
+/**
+ * int read_checkpoint(const char *path, int frames)
+ *
+ * Replace every algorithm's state with the one saved in path and move the
+ * trace cursor to the saved ref. The run must be configured the same way
+ * as the one that wrote it, apart from the number of frames.
+ *
+ * @param path {const char*} checkpoint file
+ * @param frames {int} frames to continue with, 0 keeps the checkpoint's
+ *
+ * @return {int} 0, or 1 if it couldn't be read or doesn't match the run
+ */
+int read_checkpoint(const char *path, int frames)
+{
+        char magic[8], label[32];
+        int saved[7], bad = 0;
+        unsigned long long saved_hash;
+        size_t i = 0;
+        FILE *f = fopen(path, "rb");
+        if(f == NULL)
+        {
+                printf("Could not open checkpoint %s\n", path);
+                return 1;
+        }
+        if(fread(magic, 1, 8, f) != 8 || memcmp(magic, "PGSIMCK3", 8) != 0 || fread(saved, sizeof(int), 7, f) != 7
+           || fread(&saved_hash, sizeof(unsigned long long), 1, f) != 1)
+        {
+                printf("%s is not a checkpoint\n", path);
+                fclose(f);
+                return 1;
+        }
+        if(saved[1] != page_ref_upper_bound || saved[2] != num_procs || saved[3] != (int)num_algos
+           || saved[4] != tlb_enabled || saved[5] != zswap_enabled)
+        {
+                printf("Checkpoint %s was written with different pages, processes, TLB or zswap settings\n", path);
+                fclose(f);
+                return 1;
+        }
+        if(saved[6] != max_page_calls || saved_hash != trace_hash)
+        {
+                printf("Checkpoint %s was written for a different trace, %d refs with checksum %016llx\n", path, saved[6], saved_hash);
+                fclose(f);
+                return 1;
+        }
+        num_frames = saved[0];
+        bad |= num_frames < 1;
+        bad |= fread(&counter, sizeof(int), 1, f) != 1;
+        bad |= fread(&last_page_ref, sizeof(int), 1, f) != 1;
+        bad |= fread(&last_pid, sizeof(int), 1, f) != 1;
+        bad |= last_pid < 0 || last_pid >= num_procs;
+        bad |= fread(&rand_state, sizeof(unsigned long long), 1, f) != 1;
+        bad |= fread(vtime, sizeof(int), num_procs, f) != (size_t)num_procs;
+        bad |= fread(page_ratios, sizeof(float), page_ref_upper_bound, f) != (size_t)page_ref_upper_bound;
+        bad |= fread(&prefetcher.last_ref, sizeof(int), 1, f) != 1;
+        bad |= fread(&prefetcher.stride, sizeof(int), 1, f) != 1;
+        bad |= fread(&prefetcher.run, sizeof(int), 1, f) != 1;
+        prefetcher.num_candidates = 0;
+        for (i = 0; i < num_algos && !bad; ++i)
+        {
+                free_algo_data_store(algos[i].data);
+                algos[i].data = create_algo_data_store();
+                if(fread(label, 1, strlen(algos[i].label) + 1, f) != strlen(algos[i].label) + 1
+                   || strcmp(label, algos[i].label) != 0)
+                        bad = 1;
+                else
+                        bad = load_algo_data(f, algos[i].data);
+        }
+        if(bad || ferror(f))
+        {
+                printf("Checkpoint %s is truncated or corrupt near byte %ld\n", path, ftell(f));
+                fclose(f);
+                return 1;
+        }
+        if(counter < 0 || counter > max_page_calls)
+        {
+                printf("Checkpoint %s is at ref %d, past the end of the refs\n", path, counter);
+                fclose(f);
+                return 1;
+        }
+        fclose(f);
+        ref_cursor = page_refs.lh_first;
+        for (i = 0; i < (size_t)counter && ref_cursor != NULL; ++i)
+                ref_cursor = ref_cursor->pages.le_next;
+        if(external.refs != NULL && external_seek(counter) != 0)
+        {
+                printf("Could not seek the out of core trace to ref %d\n", counter);
+                return 1;
+        }
+        if(frames > 0 && frames != num_frames)
+        {
+                for (i = 0; i < num_algos; ++i)
+                        resize_frames(algos[i].data, frames);
+                num_frames = frames;
+        }
+        return 0;
+}
+
+/**
+ * int save_frame(FILE *f, Frame *frame)
+ *
+ * Write a frame's fields, not its list links
+ *
+ * @param f {FILE*} checkpoint being written
+ * @param frame {Frame*} frame to write
+ *
+ * @return 0
+ */
+int save_frame(FILE *f, Frame *frame)
+{
+        fwrite(&frame->index, sizeof(int), 1, f);
+        fwrite(&frame->page, sizeof(int), 1, f);
+        fwrite(&frame->time, sizeof(time_t), 1, f);
+        fwrite(&frame->extra, sizeof(int), 1, f);
+        fwrite(&frame->prefetched, sizeof(int), 1, f);
+        fwrite(&frame->pid, sizeof(int), 1, f);
+        return 0;
+}
+
+/**
+ * int load_frame(FILE *f, Frame *frame)
+ *
+ * Read a frame's fields written by save_frame()
+ *
+ * @param f {FILE*} checkpoint being read
+ * @param frame {Frame*} frame to fill
+ *
+ * @return {int} 0, or 1 if the checkpoint ended or the frame is out of range
+ */
+int load_frame(FILE *f, Frame *frame)
+{
+        int bad = 0;
+        bad |= fread(&frame->index, sizeof(int), 1, f) != 1;
+        bad |= fread(&frame->page, sizeof(int), 1, f) != 1;
+        bad |= fread(&frame->time, sizeof(time_t), 1, f) != 1;
+        bad |= fread(&frame->extra, sizeof(int), 1, f) != 1;
+        bad |= fread(&frame->prefetched, sizeof(int), 1, f) != 1;
+        bad |= fread(&frame->pid, sizeof(int), 1, f) != 1;
+        return bad || frame->page < -1 || frame->page >= page_ref_upper_bound || frame->pid < 0 || frame->pid >= num_procs;
+}
+
+/**
+ * int save_algo_data(FILE *f, Algorithm_Data *data)
+ *
+ * Write an algorithm's counters, frames, clock hand and models. Pointers
+ * into the page table are written as frame indexes. The victim history
+ * grows with the trace and nothing reads it back, so it's left out.
+ *
+ * @param f {FILE*} checkpoint being written
+ * @param data {Algorithm_Data*} algorithm state to write
+ *
+ * @return 0
+ */
+int save_algo_data(FILE *f, Algorithm_Data *data)
+{
+        Frame *framep;
+        Zswap_Entry *zentry;
+        Lecar_Entry *entry;
+        Lecar_Bucket *bucket;
+        int i, n, hand = data->hand == NULL ? -1 : data->hand->index,
+            regions = (page_ref_upper_bound >> 9) + 1, has_lecar = data->lecar != NULL;
+        fwrite(&data->hits, sizeof(int), 1, f);
+        fwrite(&data->misses, sizeof(int), 1, f);
+        fwrite(&data->resident, sizeof(int), 1, f);
+        fwrite(&data->space_time, sizeof(long), 1, f);
+        fwrite(&data->prefetches, sizeof(int), 1, f);
+        fwrite(&data->prefetch_hits, sizeof(int), 1, f);
+        fwrite(&data->prefetch_wasted, sizeof(int), 1, f);
+        fwrite(&data->evictions, sizeof(int), 1, f);
+        fwrite(data->proc_extra, sizeof(int), num_procs, f);
+        for (framep = data->page_table.lh_first; framep != NULL; framep = framep->frames.le_next)
+                save_frame(f, framep);
+        fwrite(&hand, sizeof(int), 1, f);
+        if(data->tlb != NULL)
+        {
+                Tlb_Level *levels[4] = {&data->tlb->l1[PAGE_4K], &data->tlb->l1[PAGE_2M], &data->tlb->l1[PAGE_1G], &data->tlb->l2};
+                for (i = 0; i < 4; ++i)
+                {
+                        fwrite(&levels[i]->entries, sizeof(int), 1, f);
+                        fwrite(levels[i]->tags, sizeof(long), levels[i]->entries, f);
+                        fwrite(levels[i]->used, sizeof(int), levels[i]->entries, f);
+                        fwrite(&levels[i]->hits, sizeof(int), 1, f);
+                        fwrite(&levels[i]->misses, sizeof(int), 1, f);
+                }
+                fwrite(&data->tlb->tick, sizeof(int), 1, f);
+                fwrite(&data->tlb->walks, sizeof(int), 1, f);
+                fwrite(&data->tlb->promotions, sizeof(int), 1, f);
+                fwrite(&data->tlb->demotions, sizeof(int), 1, f);
+                fwrite(data->tlb->region_pages, sizeof(int), regions, f);
+                fwrite(data->tlb->region_huge, sizeof(char), regions, f);
+        }
+        if(data->zswap != NULL)
+        {
+                Zswap *zswap = data->zswap;
+                for (n = 0, zentry = zswap->lru.tqh_first; zentry != NULL; zentry = zentry->entries.tqe_next)
+                        n++;
+                fwrite(&n, sizeof(int), 1, f);
+                for (zentry = zswap->lru.tqh_first; zentry != NULL; zentry = zentry->entries.tqe_next)
+                {
+                        fwrite(&zentry->page, sizeof(int), 1, f);
+                        fwrite(&zentry->size, sizeof(int), 1, f);
+                }
+                fwrite(zswap->swapped, sizeof(char), page_ref_upper_bound, f);
+                fwrite(&zswap->used, sizeof(long), 1, f);
+                fwrite(&zswap->stores, sizeof(int), 1, f);
+                fwrite(&zswap->rejects, sizeof(int), 1, f);
+                fwrite(&zswap->loads, sizeof(int), 1, f);
+                fwrite(&zswap->writebacks, sizeof(int), 1, f);
+                fwrite(&zswap->swapins, sizeof(int), 1, f);
+                fwrite(&zswap->cpu_us, sizeof(double), 1, f);
+                fwrite(&zswap->io_us, sizeof(double), 1, f);
+        }
+        fwrite(&has_lecar, sizeof(int), 1, f);
+        if(has_lecar)
+        {
+                Lecar *lecar = data->lecar;
+                fwrite(&lecar->num_free, sizeof(int), 1, f);
+                for (i = 0; i < lecar->num_free; ++i)
+                        fwrite(&lecar->free[i]->index, sizeof(int), 1, f);
+                TAILQ_FOREACH(entry, &lecar->lru, recency)
+                        fwrite(&entry->frame->index, sizeof(int), 1, f); // resident pages, num_frames - num_free of them
+                TAILQ_FOREACH(bucket, &lecar->lfu, buckets)
+                { // Buckets in freq order, each in its recency order
+                        for (n = 0, entry = TAILQ_FIRST(&bucket->entries); entry != NULL; entry = TAILQ_NEXT(entry, frequency))
+                                n++;
+                        fwrite(&bucket->freq, sizeof(int), 1, f);
+                        fwrite(&n, sizeof(int), 1, f);
+                        TAILQ_FOREACH(entry, &bucket->entries, frequency)
+                                fwrite(&entry->frame->index, sizeof(int), 1, f);
+                }
+                n = 0;
+                fwrite(&n, sizeof(int), 1, f); // No more buckets
+                fwrite(lecar->ghost, sizeof(char), page_ref_upper_bound, f);
+                fwrite(lecar->ghost_slot, sizeof(int), page_ref_upper_bound, f);
+                fwrite(lecar->ghost_time, sizeof(int), page_ref_upper_bound, f);
+                fwrite(lecar->history[EXPERT_LRU], sizeof(int), num_frames, f);
+                fwrite(lecar->history[EXPERT_LFU], sizeof(int), num_frames, f);
+                fwrite(lecar->history_pos, sizeof(int), 2, f);
+                fwrite(lecar->weight, sizeof(double), 2, f);
+                fwrite(&lecar->discount, sizeof(double), 1, f);
+        }
+        return 0;
+}
+
+/**
+ * int load_algo_data(FILE *f, Algorithm_Data *data)
+ *
+ * Fill an empty algorithm data, as made by create_algo_data_store() with
+ * the checkpoint's num_frames, with state written by save_algo_data()
+ *
+ * @param f {FILE*} checkpoint being read
+ * @param data {Algorithm_Data*} empty algorithm data to fill
+ *
+ * @return {int} 0, or 1 if the checkpoint ended or doesn't match the run
+ */
+int load_algo_data(FILE *f, Algorithm_Data *data)
+{
+        Frame **frame_at = malloc(sizeof(Frame*)*num_frames), *framep;
+        Zswap_Entry *zentry;
+        Lecar_Entry *entry;
+        Lecar_Bucket *bucket;
+        int i, n, hand = -1, entries, idx, freq, has_lecar = 0, bad = 0,
+            regions = (page_ref_upper_bound >> 9) + 1;
+        bad |= fread(&data->hits, sizeof(int), 1, f) != 1;
+        bad |= fread(&data->misses, sizeof(int), 1, f) != 1;
+        bad |= fread(&data->resident, sizeof(int), 1, f) != 1;
+        bad |= fread(&data->space_time, sizeof(long), 1, f) != 1;
+        bad |= fread(&data->prefetches, sizeof(int), 1, f) != 1;
+        bad |= fread(&data->prefetch_hits, sizeof(int), 1, f) != 1;
+        bad |= fread(&data->prefetch_wasted, sizeof(int), 1, f) != 1;
+        bad |= fread(&data->evictions, sizeof(int), 1, f) != 1;
+        bad |= fread(data->proc_extra, sizeof(int), num_procs, f) != (size_t)num_procs;
+        for (i = 0, framep = data->page_table.lh_first; framep != NULL; framep = framep->frames.le_next)
+        {
+                bad |= load_frame(f, framep);
+                frame_at[i++] = framep;
+        }
+        bad |= fread(&hand, sizeof(int), 1, f) != 1;
+        if(bad)
+        {
+                free(frame_at);
+                return 1;
+        }
+        data->hand = hand >= 0 && hand < num_frames ? frame_at[hand] : NULL;
+        if(data->tlb != NULL)
+        {
+                Tlb_Level *levels[4] = {&data->tlb->l1[PAGE_4K], &data->tlb->l1[PAGE_2M], &data->tlb->l1[PAGE_1G], &data->tlb->l2};
+                for (i = 0; i < 4; ++i)
+                {
+                        if(fread(&entries, sizeof(int), 1, f) != 1 || entries != levels[i]->entries)
+                        { // TLB geometry changed
+                                free(frame_at);
+                                return 1;
+                        }
+                        bad |= fread(levels[i]->tags, sizeof(long), levels[i]->entries, f) != (size_t)levels[i]->entries;
+                        bad |= fread(levels[i]->used, sizeof(int), levels[i]->entries, f) != (size_t)levels[i]->entries;
+                        bad |= fread(&levels[i]->hits, sizeof(int), 1, f) != 1;
+                        bad |= fread(&levels[i]->misses, sizeof(int), 1, f) != 1;
+                }
+                bad |= fread(&data->tlb->tick, sizeof(int), 1, f) != 1;
+                bad |= fread(&data->tlb->walks, sizeof(int), 1, f) != 1;
+                bad |= fread(&data->tlb->promotions, sizeof(int), 1, f) != 1;
+                bad |= fread(&data->tlb->demotions, sizeof(int), 1, f) != 1;
+                bad |= fread(data->tlb->region_pages, sizeof(int), regions, f) != (size_t)regions;
+                bad |= fread(data->tlb->region_huge, sizeof(char), regions, f) != (size_t)regions;
+        }
+        if(data->zswap != NULL)
+        {
+                Zswap *zswap = data->zswap;
+                n = 0;
+                bad |= fread(&n, sizeof(int), 1, f) != 1;
+                for (i = 0; i < n && !bad; ++i)
+                { // Written head first, append to keep LRU order
+                        zentry = malloc(sizeof(Zswap_Entry));
+                        bad |= fread(&zentry->page, sizeof(int), 1, f) != 1;
+                        bad |= fread(&zentry->size, sizeof(int), 1, f) != 1;
+                        if(bad || zentry->page < 0 || zentry->page >= page_ref_upper_bound)
+                        {
+                                free(zentry);
+                                free(frame_at);
+                                return 1;
+                        }
+                        TAILQ_INSERT_TAIL(&zswap->lru, zentry, entries);
+                        zswap->pages[zentry->page] = zentry;
+                }
+                bad |= fread(zswap->swapped, sizeof(char), page_ref_upper_bound, f) != (size_t)page_ref_upper_bound;
+                bad |= fread(&zswap->used, sizeof(long), 1, f) != 1;
+                bad |= fread(&zswap->stores, sizeof(int), 1, f) != 1;
+                bad |= fread(&zswap->rejects, sizeof(int), 1, f) != 1;
+                bad |= fread(&zswap->loads, sizeof(int), 1, f) != 1;
+                bad |= fread(&zswap->writebacks, sizeof(int), 1, f) != 1;
+                bad |= fread(&zswap->swapins, sizeof(int), 1, f) != 1;
+                bad |= fread(&zswap->cpu_us, sizeof(double), 1, f) != 1;
+                bad |= fread(&zswap->io_us, sizeof(double), 1, f) != 1;
+        }
+        bad |= fread(&has_lecar, sizeof(int), 1, f) != 1;
+        if(has_lecar)
+        {
+                Lecar *lecar = data->lecar = create_lecar(data);
+                bad |= fread(&lecar->num_free, sizeof(int), 1, f) != 1;
+                for (i = 0; i < lecar->num_free && i < num_frames; ++i)
+                {
+                        idx = -1;
+                        bad |= fread(&idx, sizeof(int), 1, f) != 1;
+                        if(bad || idx < 0 || idx >= num_frames)
+                                break;
+                        lecar->free[i] = frame_at[idx];
+                }
+                if(i != lecar->num_free)
+                {
+                        free(frame_at);
+                        return 1;
+                }
+                for (i = 0; i < num_frames - lecar->num_free; ++i)
+                {
+                        idx = -1;
+                        bad |= fread(&idx, sizeof(int), 1, f) != 1;
+                        if(idx < 0 || idx >= num_frames || frame_at[idx]->page < 0)
+                        {
+                                free(frame_at);
+                                return 1;
+                        }
+                        entry = malloc(sizeof(Lecar_Entry));
+                        entry->frame = frame_at[idx];
+                        entry->bucket = NULL;
+                        TAILQ_INSERT_TAIL(&lecar->lru, entry, recency);
+                        lecar->pages[entry->frame->page] = entry;
+                }
+                for (;;)
+                { // Buckets until a 0 freq
+                        bad |= fread(&freq, sizeof(int), 1, f) != 1;
+                        if(bad || freq <= 0)
+                                break;
+                        bucket = malloc(sizeof(Lecar_Bucket));
+                        bucket->freq = freq;
+                        TAILQ_INIT(&bucket->entries);
+                        TAILQ_INSERT_TAIL(&lecar->lfu, bucket, buckets);
+                        n = 0;
+                        bad |= fread(&n, sizeof(int), 1, f) != 1;
+                        for (i = 0; i < n && !bad; ++i)
+                        {
+                                idx = -1;
+                                bad |= fread(&idx, sizeof(int), 1, f) != 1;
+                                if(idx < 0 || idx >= num_frames || frame_at[idx]->page < 0
+                                   || (entry = lecar->pages[frame_at[idx]->page]) == NULL)
+                                {
+                                        free(frame_at);
+                                        return 1;
+                                }
+                                entry->bucket = bucket;
+                                TAILQ_INSERT_TAIL(&bucket->entries, entry, frequency);
+                        }
+                }
+                bad |= fread(lecar->ghost, sizeof(char), page_ref_upper_bound, f) != (size_t)page_ref_upper_bound;
+                bad |= fread(lecar->ghost_slot, sizeof(int), page_ref_upper_bound, f) != (size_t)page_ref_upper_bound;
+                bad |= fread(lecar->ghost_time, sizeof(int), page_ref_upper_bound, f) != (size_t)page_ref_upper_bound;
+                bad |= fread(lecar->history[EXPERT_LRU], sizeof(int), num_frames, f) != (size_t)num_frames;
+                bad |= fread(lecar->history[EXPERT_LFU], sizeof(int), num_frames, f) != (size_t)num_frames;
+                bad |= fread(lecar->history_pos, sizeof(int), 2, f) != 2;
+                bad |= fread(lecar->weight, sizeof(double), 2, f) != 2;
+                bad |= fread(&lecar->discount, sizeof(double), 1, f) != 1;
+                for (i = 0; i < num_frames && !bad; ++i) // History pages index per page arrays
+                        bad = lecar->history[EXPERT_LRU][i] < -1 || lecar->history[EXPERT_LRU][i] >= page_ref_upper_bound
+                              || lecar->history[EXPERT_LFU][i] < -1 || lecar->history[EXPERT_LFU][i] >= page_ref_upper_bound;
+                bad |= lecar->history_pos[EXPERT_LRU] < 0 || lecar->history_pos[EXPERT_LRU] >= num_frames
+                       || lecar->history_pos[EXPERT_LFU] < 0 || lecar->history_pos[EXPERT_LFU] >= num_frames;
+        }
+        free(frame_at);
+        return bad;
+}
+
+/**
+ * int resize_frames(Algorithm_Data *data, int frames)
+ *
+ * Give an algorithm a different number of frames, as if memory were hot
+ * added or removed. New frames are empty and go after the existing ones;
+ * removed frames are the highest numbered, their pages evicted as victims.
+ * Call before updating num_frames, which must still be the old count.
+ *
+ * @param data {Algorithm_Data*} algorithm to resize
+ * @param frames {int} new number of frames
+ *
+ * @return 0
+ */
+int resize_frames(Algorithm_Data *data, int frames)
+{
+        Frame *framep = data->page_table.lh_first, *nextp;
+        int i, n;
+        if(data->lecar != NULL)
+        { // Free frames being removed leave the free stack
+                for (i = 0, n = 0; i < data->lecar->num_free; ++i)
+                        if(data->lecar->free[i]->index < frames)
+                                data->lecar->free[n++] = data->lecar->free[i];
+                data->lecar->num_free = n;
+        }
+        for (i = 1; i < frames && framep->frames.le_next != NULL; ++i)
+                framep = framep->frames.le_next;
+        while((nextp = framep->frames.le_next) != NULL)
+        { // Shrinking, evict and drop frames past the new end
+                if(nextp->page > -1)
+                {
+                        add_victim(data, nextp);
+                        if(data->lecar != NULL)
+                                data->lecar->num_free--; // add_victim() pushed it on the free stack
+                }
+                if(data->hand == nextp)
+                        data->hand = NULL;
+                LIST_REMOVE(nextp, frames);
+                free(nextp);
+        }
+        if(data->lecar != NULL)
+                lecar_resize(data->lecar, frames);
+        for (i = num_frames; i < frames; ++i)
+        { // Growing, LIST_INSERT_AFTER evaluates elm more than once, create frame first
+                nextp = create_empty_frame(i);
+                LIST_INSERT_AFTER(framep, nextp, frames);
+                framep = nextp;
+                if(data->lecar != NULL)
+                        data->lecar->free[data->lecar->num_free++] = nextp;
+        }
+        return 0;
+}
+
+/**
+ * int lecar_resize(Lecar *lecar, int frames)
+ *
+ * Resize LECAR's free stack and ghost lists from num_frames to frames
+ * long. Ghost lists keep their newest entries.
+ *
+ * @param lecar {Lecar*} LECAR state
+ * @param frames {int} new number of frames
+ *
+ * @return 0
+ */
+int lecar_resize(Lecar *lecar, int frames)
+{
+        int expert, i, j, slot, page_ref, *ring,
+            keep = frames < num_frames ? frames : num_frames;
+        lecar->free = realloc(lecar->free, sizeof(Frame*)*frames);
+        for (expert = EXPERT_LRU; expert <= EXPERT_LFU; ++expert)
+        {
+                ring = malloc(sizeof(int)*frames);
+                memset(ring, -1, sizeof(int)*frames);
+                for (i = 0; i < num_frames; ++i)
+                { // Oldest to newest
+                        slot = (lecar->history_pos[expert] + i) % num_frames;
+                        page_ref = lecar->history[expert][slot];
+                        j = i - (num_frames - keep);
+                        if(j >= 0)
+                                ring[j] = page_ref;
+                        if(page_ref < 0 || lecar->ghost[page_ref] != expert + 1 || lecar->ghost_slot[page_ref] != slot)
+                                continue; // Stale slot
+                        if(j >= 0)
+                                lecar->ghost_slot[page_ref] = j;
+                        else
+                                lecar->ghost[page_ref] = 0; // Fell off the shorter ghost list
+                }
+                free(lecar->history[expert]);
+                lecar->history[expert] = ring;
+                lecar->history_pos[expert] = keep % frames;
+        }
+        lecar->discount = pow(0.005, 1.0/frames);
+        return 0;
+}
+
+/**
+ * int resume_loop()
+ *
+ * Continue from resume_file to the last ref. With what-if frame counts the
+ * checkpoint is restored and run once per count, so the shared prefix is
+ * only simulated once, by the run that wrote the checkpoint.
+ *
+ * @return {int} 0, or 1 if the checkpoint couldn't be restored
+ */
+int resume_loop()
+{
+        int n;
+        if(num_forks == 0)
+        {
+                if(read_checkpoint(resume_file, 0) != 0)
+                        return 1;
+                printf("Resumed %s at ref %d\n", resume_file, counter);
+                return event_loop();
+        }
+        for (n = 0; n < num_forks; ++n)
+        {
+                if(read_checkpoint(resume_file, fork_frames[n]) != 0)
+                        return 1;
+                printf("What-if %d frames, from %s at ref %d\n", fork_frames[n], resume_file, counter);
+                event_loop();
+        }
+        return 0;
+}
+
+/**
+ * int analyze_trace()
+ *
+ * Stream the trace once, or the generated refs without a trace, and print
+ * its reuse time histogram, average footprint for every window length,
+ * working set size per epoch and hot page skew. Refs are never held in
+ * memory, sketches are fixed size and only pages sampled by analyze_rate
+ * are tracked individually.
+ *
+ * @return {int} 0, or 1 if trace couldn't be read
+ */
+int analyze_trace()
+{
+        Trace_Analysis *analysis = calloc(1, sizeof(Trace_Analysis));
+        FILE *trace = NULL;
+        Page_Ref *page = page_refs.lh_first;
+        char line[256];
+        int page_num;
+        long i;
+        if(trace_file != NULL && (trace = fopen(trace_file, "r")) == NULL)
+        {
+                printf( "Could not open trace %s\n", trace_file);
+                free(analysis);
+                return 1;
+        }
+        analysis->table_size = 1024;
+        analysis->epoch_start = 1;
+        analysis->pages = malloc(sizeof(Page_Stats)*analysis->table_size);
+        for (i = 0; i < analysis->table_size; ++i)
+                analysis->pages[i].page = -1;
+        analysis->top_pages = malloc(sizeof(int)*analyze_topk);
+        analysis->top_counts = calloc(analyze_topk, sizeof(long));
+        analysis->top_errors = calloc(analyze_topk, sizeof(long));
+        for (i = 0; i < analyze_topk; ++i)
+                analysis->top_pages[i] = -1;
+        printf("Working Set Size, epochs of %d refs\n", analyze_epoch);
+        while(trace != NULL ? fgets(line, sizeof(line), trace) != NULL : page != NULL && analysis->refs < max_page_calls)
+        {
+                if(trace == NULL)
+                {
+                        page_num = page->page_num;
+                        page = page->pages.le_next;
+                }
+                else if(line[0] == '#' || sscanf(line, "%d", &page_num) != 1 || page_num < 0)
+                {
+                        continue;
+                }
+                else if(refs_limited && analysis->refs >= max_page_calls)
+                {
+                        break;
+                }
+                analyze_ref(analysis, page_num);
+        }
+        if(trace != NULL)
+                fclose(trace);
+        print_analysis(analysis);
+        free(analysis->pages);
+        free(analysis->top_pages);
+        free(analysis->top_counts);
+        free(analysis->top_errors);
+        free(analysis);
+        return 0;
+}
+
+/**
+ * int analyze_ref(Trace_Analysis *analysis, int page_ref)
+ *
+ * Add one ref to the sketches, and for sampled pages to the reuse time and
+ * first ref histograms and the epoch working set
+ *
+ * @param analysis {Trace_Analysis*} analysis state
+ * @param page_ref {int} page referenced
+ *
+ * @return 0
+ */
+int analyze_ref(Trace_Analysis *analysis, int page_ref)
+{
+        unsigned long long hash = hash64((unsigned long long)page_ref);
+        Page_Stats *stats;
+        long reuse, min = -1;
+        int i, bin, rank, slot = -1;
+        if(analysis->refs > 0 && analysis->refs % analyze_epoch == 0)
+        { // Epoch over, report its working set
+                printf("Epoch: %ld, WSS: %.0f\n", analysis->refs / analyze_epoch - 1, analysis->epoch_pages / analyze_rate);
+                analysis->epoch_start = analysis->refs + 1;
+                analysis->epoch_pages = 0;
+        }
+        analysis->refs++;
+        /* HyperLogLog, top 12 bits pick the register, rank of the rest */
+        for (rank = 1; rank < 53 && !(hash & (1ULL << (52 - rank))); ++rank);
+        if(rank > analysis->hll[hash >> 52])
+                analysis->hll[hash >> 52] = rank;
+        /* Count-Min */
+        for (i = 0; i < 4; ++i)
+                analysis->cms[i][hash64(hash + i) & 1023]++;
+        /* Space-Saving, replace the least counted page if not monitored */
+        for (i = 0; i < analyze_topk && analysis->top_pages[i] != page_ref; ++i)
+                if(min == -1 || analysis->top_counts[i] < min)
+                {
+                        min = analysis->top_counts[i];
+                        slot = i;
+                }
+        if(i < analyze_topk)
+        {
+                analysis->top_counts[i]++;
+        }
+        else
+        {
+                analysis->top_pages[slot] = page_ref;
+                analysis->top_errors[slot] = analysis->top_counts[slot];
+                analysis->top_counts[slot]++;
+        }
+        /* Reuse of sampled pages */
+        if((double)(hash & 0xffffff) >= analyze_rate * 0x1000000)
+                return 0;
+        stats = analysis_page(analysis, page_ref);
+        if(stats->first == 0)
+        { // First ref
+                stats->first = analysis->refs;
+                for (bin = 0; (2L << bin) <= analysis->refs; ++bin);
+                analysis->first_count[bin]++;
+                analysis->first_sum[bin] += analysis->refs;
+        }
+        else
+        {
+                reuse = analysis->refs - stats->last;
+                for (bin = 0; (2L << bin) <= reuse; ++bin);
+                analysis->reuse_count[bin]++;
+                analysis->reuse_sum[bin] += reuse;
+        }
+        if(stats->last < analysis->epoch_start)
+                analysis->epoch_pages++;
+        stats->last = analysis->refs;
+        return 0;
+}
+
+/**
+ * Page_Stats* analysis_page(Trace_Analysis *analysis, int page_ref)
+ *
+ * Find a sampled page in the analysis table, adding it if new and growing
+ * the table once half full
+ *
+ * @param analysis {Trace_Analysis*} analysis state
+ * @param page_ref {int} page to find
+ *
+ * @return {Page_Stats*} page's entry
+ */
+Page_Stats *analysis_page(Trace_Analysis *analysis, int page_ref)
+{
+        Page_Stats *old = analysis->pages;
+        long i, j, size = analysis->table_size;
+        if(analysis->num_pages * 2 >= analysis->table_size)
+        { // Grow and rehash
+                analysis->table_size *= 2;
+                analysis->pages = malloc(sizeof(Page_Stats)*analysis->table_size);
+                for (i = 0; i < analysis->table_size; ++i)
+                        analysis->pages[i].page = -1;
+                for (i = 0; i < size; ++i)
+                {
+                        if(old[i].page == -1)
+                                continue;
+                        for (j = hash64(old[i].page) & (analysis->table_size - 1); analysis->pages[j].page != -1; j = (j + 1) & (analysis->table_size - 1));
+                        analysis->pages[j] = old[i];
+                }
+                free(old);
+        }
+        for (i = hash64(page_ref) & (analysis->table_size - 1); analysis->pages[i].page != -1; i = (i + 1) & (analysis->table_size - 1))
+                if(analysis->pages[i].page == page_ref)
+                        return &analysis->pages[i];
+        analysis->pages[i].page = page_ref;
+        analysis->pages[i].first = 0;
+        analysis->pages[i].last = 0;
+        analysis->num_pages++;
+        return &analysis->pages[i];
+}
+
+/**
+ * int print_analysis(Trace_Analysis *analysis)
+ *
+ * Print unique pages, reuse time histogram, average footprint and hot page
+ * skew. Footprint uses Xiang et al.'s all-window formula, exact at power of
+ * 2 windows from log2 binned reuse, first ref and last ref times:
+ * fp(w) = m - (sum over x > w of (x - w), for reuse times, first ref times
+ * and times from last ref to end) / (n - w + 1)
+ *
+ * @param analysis {Trace_Analysis*} analysis state
+ *
+ * @return 0
+ */
+int print_analysis(Trace_Analysis *analysis)
+{
+        double last_count[64] = {0}, last_sum[64] = {0},
+               hll_sum = 0, unique, excess, covered = 0, estimate;
+        long n = analysis->refs, w, i, x;
+        int bin, zeros = 0, k;
+        if(n == 0)
+        {
+                printf("No page refs to analyze\n");
+                return 0;
+        }
+        /* Epoch in progress */
+        printf("Epoch: %ld, WSS: %.0f\n", (n - 1) / analyze_epoch, analysis->epoch_pages / analyze_rate);
+        /* Time from each sampled page's last ref to the end */
+        for (i = 0; i < analysis->table_size; ++i)
+        {
+                if(analysis->pages[i].page == -1)
+                        continue;
+                x = n + 1 - analysis->pages[i].last;
+                for (bin = 0; (2L << bin) <= x; ++bin);
+                last_count[bin]++;
+                last_sum[bin] += x;
+        }
+        for (i = 0; i < 4096; ++i)
+        {
+                hll_sum += 1.0 / (double)(1ULL << analysis->hll[i]);
+                if(analysis->hll[i] == 0)
+                        zeros++;
+        }
+        unique = 0.7213 / (1 + 1.079 / 4096) * 4096.0 * 4096.0 / hll_sum;
+        if(unique <= 2.5 * 4096 && zeros > 0)
+                unique = 4096.0 * log(4096.0 / zeros); // Linear counting for small sets
+        printf("Trace Analysis\n");
+        printf("Refs: %ld, ", n);
+        printf("Unique Pages (HLL): %.0f, ", unique);
+        printf("Sampling Rate: %f\n", analyze_rate);
+        printf("Reuse Time Histogram\n");
+        printf("Cold Refs: %.0f\n", analysis->num_pages / analyze_rate);
+        for (bin = 0; bin < 64 && (1L << bin) <= n; ++bin)
+                if(analysis->reuse_count[bin] > 0)
+                        printf("Reuse Time: %ld-%ld, Refs: %.0f\n", 1L << bin, (2L << bin) - 1, analysis->reuse_count[bin] / analyze_rate);
+        printf("Average Footprint\n");
+        for (w = 1; w <= n; w *= 2)
+        {
+                for (bin = 0; (2L << bin) <= w; ++bin);
+                for (excess = 0; bin < 64; ++bin)
+                        excess += analysis->reuse_sum[bin] - w * analysis->reuse_count[bin]
+                                + analysis->first_sum[bin] - w * analysis->first_count[bin]
+                                + last_sum[bin] - w * last_count[bin];
+                printf("Window: %ld, Footprint: %f\n", w, (analysis->num_pages - excess / (n - w + 1)) / analyze_rate);
+        }
+        printf("Hot Pages, Space-Saving top %d\n", analyze_topk);
+        for (k = 0; k < analyze_topk; ++k)
+        { // Selection sort by count, list is small
+                for (i = k + 1; i < analyze_topk; ++i)
+                        if(analysis->top_counts[i] > analysis->top_counts[k])
+                        {
+                                x = analysis->top_counts[i]; analysis->top_counts[i] = analysis->top_counts[k]; analysis->top_counts[k] = x;
+                                x = analysis->top_errors[i]; analysis->top_errors[i] = analysis->top_errors[k]; analysis->top_errors[k] = x;
+                                bin = analysis->top_pages[i]; analysis->top_pages[i] = analysis->top_pages[k]; analysis->top_pages[k] = bin;
+                        }
+                if(analysis->top_pages[k] == -1)
+                        break;
+                /* Count-Min can tighten Space-Saving's overestimate */
+                unsigned long long hash = hash64((unsigned long long)analysis->top_pages[k]);
+                for (i = 0, estimate = analysis->top_counts[k]; i < 4; ++i)
+                        if(analysis->cms[i][hash64(hash + i) & 1023] < estimate)
+                                estimate = analysis->cms[i][hash64(hash + i) & 1023];
+                if(analysis->top_counts[k] - analysis->top_errors[k] > estimate)
+                        estimate = analysis->top_counts[k] - analysis->top_errors[k];
+                covered += estimate;
+                if(k < 10)
+                        printf("Page: %d, Refs: %.0f\n", analysis->top_pages[k], estimate);
+                if(k == 0 || k == 9)
+                        printf("Top %d Coverage: %f\n", k + 1, covered / n);
+        }
+        if(k != 1 && k != 10) // Not printed in the loop already
+                printf("Top %d Coverage: %f\n", k, covered / n);
+        return 0;
+}
+
+/**
+ * unsigned long long hash64(unsigned long long x)
+ *
+ * Mix the bits of a key (splitmix64 finalizer) for sketches and tables
+ *
+ * @param x {unsigned long long} key
+ *
+ * @return {unsigned long long} hash
+ */
+unsigned long long hash64(unsigned long long x)
+{
+        x += 0x9e3779b97f4a7c15ULL;
+        x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+        x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+        return x ^ (x >> 31);
+}
+
+/**
+ * unsigned long long hash_ref(unsigned long long hash, int page_ref, float ratio, int pid)
+ *
+ * Fold one ref into a running checksum of a trace
+ *
+ * @param hash {unsigned long long} checksum of the refs before this one
+ * @param page_ref {int} page referenced
+ * @param ratio {float} compression ratio the ref gives, 0 if none
+ * @param pid {int} process making the ref
+ *
+ * @return {unsigned long long} checksum including this ref
+ */
+unsigned long long hash_ref(unsigned long long hash, int page_ref, float ratio, int pid)
+{
+        uint32_t bits;
+        memcpy(&bits, &ratio, sizeof(bits));
+        return hash64(hash64(hash64(hash ^ (uint32_t)page_ref) ^ (uint32_t)pid) ^ bits);
+}
+
+/**
+ * int next_rand()
+ *
+ * Draw from the simulation's random number generator, a splitmix64
+ * sequence whose whole state is rand_state, so a checkpoint can save it
+ *
+ * @return {int} random number from 0 to RAND_MAX
+ */
+int next_rand()
+{
+        rand_state += 0x9e3779b97f4a7c15ULL;
+        return (int)(hash64(rand_state) >> 33) & RAND_MAX;
+}
+
+/**
+ * int get_ref()
+ *
+ * get a random ref
+ *
+ * @return {int}
+ */
+int get_ref()
+{
+        if (external.refs != NULL)
+        { // out of core trace
+                return external_ref();
+        }
+        else if (ref_cursor != NULL)
+        { // read Page_Ref at cursor and move on, page_refs stays intact for replays
+                int page_num = ref_cursor->page_num;
+                if(ref_cursor->ratio > 0)
+                        page_ratios[page_num] = ref_cursor->ratio;
+                last_pid = ref_cursor->pid;
+                ref_cursor = ref_cursor->pages.le_next;
+                return page_num;
+        }
+        else
+        { // just in case
+                last_pid = 0;
+                return next_rand() % page_ref_upper_bound;
+        }
+}
+
+/**
+ * int page()
+ *
+ * page all selected algorithms with input ref
+ *
+ * @param page_ref {int} page to ref
+ *
+ * @return 0
+ */
+int page(int page_ref)
+{
+        last_page_ref = page_ref;
+        vtime[last_pid]++;
+        if(prefetch_mode != PREFETCH_NONE)
+                prefetch_detect(page_ref);
+        if(partitions != NULL)
+                return partition_page(page_ref);
+        size_t i = 0;
+        for (i = 0; i < num_algos; i++)
+        {
+                if(algos[i].selected==1) {
+                        page_algo(&algos[i], page_ref);
+                }
+        }
+
+        return 0;
+}
+
+/**
+ * int page_algo(Algorithm *algo, int page_ref)
+ *
+ * page one algorithm's page table with input ref, algo->data may be a
+ * partition's page table rather than the algorithm's own
+ *
+ * @param algo {Algorithm*} algorithm and page table to page
+ * @param page_ref {int} page to ref
+ *
+ * @return {int} did page fault, 0 or 1
+ */
+int page_algo(Algorithm *algo, int page_ref)
+{
+        int fault, trigger = 0;
+        if(prefetch_mode != PREFETCH_NONE)
+                trigger = prefetch_check(algo->data, page_ref);
+        fault = algo->algo(algo->data);
+        if(fault == 1) algo->data->misses++; else algo->data->hits++;
+        if(fault == 1)
+                page_in(algo->data, page_ref);
+        if(algo->data->tlb != NULL)
+                tlb_translate(algo->data->tlb, page_ref, fault);
+        if(prefetch_mode != PREFETCH_NONE && (fault == 1 || trigger == 1))
+                prefetch_issue(algo);
+        algo->data->space_time += algo->data->resident;
+        if(printrefs == 1)
+        {
+                print_stats(*algo);
+        }
+        return fault;
+}
+
+/**
+ * int add_victim(Algorithm_Data *data, struct Frame *frame)
+ *
+ * Add victim frame evicted from page table to list of victims
+ *
+ * @param data {Algorithm_Data} algorithm the frame was evicted from
+ * @param page {Frame} page frame evicted
+ *
+ * @retun 0
+ */
+int add_victim(Algorithm_Data *data, struct Frame *frame)
+{
+        if(debug)
+                printf("Victim index: %d, Page: %d\n", frame->index, frame->page);
+        struct Frame *victim = malloc(sizeof(Frame));
+        *victim = *frame;
+        victim->index = 1;
+        LIST_INSERT_HEAD(&data->victim_list, victim, frames);
+        data->resident--;
+        data->evictions++;
+        if(data->tlb != NULL)
+                tlb_unmap(data->tlb, frame->page);
+        if(data->zswap != NULL)
+                zswap_store(data->zswap, frame->page);
+        if(data->lecar != NULL)
+                lecar_forget(data->lecar, frame);
+        if(frame->prefetched > -1)
+        { // Prefetched page never got used
+                data->prefetch_wasted++;
+                frame->prefetched = -1;
+        }
+        return 0;
+}
+
+/**
+ * int page_in(Algorithm_Data *data, int page_ref)
+ *
+ * Update the models behind a page table after a page is faulted into it
+ *
+ * @param data {Algorithm_Data} algorithm the page was faulted into
+ * @param page_ref {int} page faulted in
+ *
+ * @return 0
+ */
+int page_in(Algorithm_Data *data, int page_ref)
+{
+        data->resident++;
+        if(data->tlb != NULL)
+                tlb_map(data->tlb, page_ref);
+        if(data->zswap != NULL)
+                zswap_load(data->zswap, page_ref);
+        return 0;
+}
+
+/**
+ * Frame* find_frame(Algorithm_Data *data, int page_ref)
+ *
+ * Find the frame holding a page in an algorithm's page table
+ *
+ * @param data {Algorithm_Data} algorithm to search
+ * @param page_ref {int} page to look for
+ *
+ * @return {Frame*} frame holding page, NULL if page isn't resident
+ */
+Frame* find_frame(Algorithm_Data *data, int page_ref)
+{
+        Frame *framep = data->page_table.lh_first;
+        while (framep != NULL && framep->page != page_ref)
+                framep = framep->frames.le_next;
+        return framep;
+}
+
+/**
+ * int partition_of(int page_ref, int pid)
+ *
+ * Partition a ref is routed to, its page's set or its process' tenant
+ *
+ * @param page_ref {int} page referenced
+ * @param pid {int} process making the ref
+ *
+ * @return {int} partition
+ */
+int partition_of(int page_ref, int pid)
+{
+        if(partition_mode == PARTITION_SETS)
+                return (int)(hash64((unsigned long long)page_ref) % num_partitions);
+        return pid % num_partitions;
+}
+
+/**
+ * int partition_page(int page_ref)
+ *
+ * page every selected algorithm's page table in the ref's partition, with
+ * num_frames set to the partition's frames and the partition's own random
+ * number state while it runs. A tenant about to fault with no empty frame
+ * first tries to borrow one. Partitions not referenced are left alone,
+ * their memory-time catches up when they're next touched.
+ *
+ * @param page_ref {int} page to ref
+ *
+ * @return 0
+ */
+int partition_page(int page_ref)
+{
+        int p = partition_of(page_ref, last_pid), j, n, frames = num_frames;
+        unsigned long long state = rand_state;
+        Algorithm view;
+        size_t i = 0;
+        if(partition_job >= 0 && p % partition_jobs != partition_job)
+                return 0; // Another worker's set
+        partition_sync(&partitions[p]);
+        partitions[p].refs++;
+        rand_state = partitions[p].rand_state;
+        if(partition_mode == PARTITION_SETS)
+        { // Only prefetch pages in the same set
+                for (j = 0, n = 0; j < prefetcher.num_candidates; ++j)
+                        if(partition_of(prefetcher.candidates[j], last_pid) == p)
+                                prefetcher.candidates[n++] = prefetcher.candidates[j];
+                prefetcher.num_candidates = n;
+        }
+        for (i = 0; i < num_algos; i++)
+        {
+                if(algos[i].selected == 0)
+                        continue;
+                view = algos[i];
+                view.data = partitions[p].data[i];
+                if(partition_mode == PARTITION_TENANTS && partitions[p].frames[i] < partitions[p].hard
+                   && view.data->resident >= partitions[p].frames[i] && find_frame(view.data, page_ref) == NULL)
+                        partition_borrow(p, i);
+                num_frames = partitions[p].frames[i];
+                page_algo(&view, page_ref);
+                num_frames = frames;
+        }
+        partitions[p].synced = counter + 1; // page_algo() added this ref
+        partitions[p].rand_state = rand_state;
+        rand_state = state;
+        return 0;
+}
+
+/**
+ * int partition_sync(Partition *part)
+ *
+ * Add a partition's resident frames for every ref since it was last
+ * touched to its memory-time. Resident frames only change when the
+ * partition is paged or lends a frame, so this is done then, and at the
+ * end, rather than every ref.
+ *
+ * @param part {Partition*} partition to bring up to the current ref
+ *
+ * @return 0
+ */
+int partition_sync(Partition *part)
+{
+        size_t i = 0;
+        for (i = 0; i < num_algos; i++)
+                part->data[i]->space_time += (long)part->data[i]->resident * (counter - part->synced);
+        part->synced = counter;
+        return 0;
+}
+
+/**
+ * int partition_borrow(int p, size_t i)
+ *
+ * Grow a full tenant by one frame for algorithm i. The frame comes from
+ * the pool no tenant holds, else from another tenant's empty frame, else,
+ * if the tenant is under its soft quota, it is reclaimed from a tenant
+ * over its soft quota by evicting that tenant's highest numbered frame.
+ * num_frames must be the whole memory's frames.
+ *
+ * @param p {int} tenant partition
+ * @param i {size_t} algorithm
+ *
+ * @return {int} 1 if a frame was borrowed, else 0
+ */
+int partition_borrow(int p, size_t i)
+{
+        Partition *lender = NULL;
+        int q, idle = 0, pool = num_frames, frames = num_frames;
+        for (q = 0; q < num_partitions; ++q)
+                pool -= partitions[q].frames[i];
+        for (q = 0; pool == 0 && lender == NULL && q < num_partitions; ++q)
+                if(q != p && partitions[q].frames[i] > 1 && partitions[q].data[i]->resident < partitions[q].frames[i])
+                {
+                        lender = &partitions[q];
+                        idle = 1;
+                }
+        for (q = 0; pool == 0 && lender == NULL && partitions[p].frames[i] < partitions[p].soft && q < num_partitions; ++q)
+                if(q != p && partitions[q].frames[i] > partitions[q].soft)
+                        lender = &partitions[q];
+        if(pool == 0 && lender == NULL)
+                return 0;
+        if(lender != NULL)
+        {
+                partition_sync(lender);
+                num_frames = lender->frames[i];
+                if(idle && remove_empty_frame(lender->data[i]) == 0)
+                { // No empty frame after all, nothing lent
+                        num_frames = frames;
+                        return 0;
+                }
+                if(!idle)
+                        resize_frames(lender->data[i], num_frames - 1);
+                lender->frames[i]--;
+                lender->reclaimed[i]++;
+        }
+        num_frames = partitions[p].frames[i];
+        resize_frames(partitions[p].data[i], num_frames + 1);
+        partitions[p].frames[i]++;
+        partitions[p].borrowed[i]++;
+        num_frames = frames;
+        return 1;
+}
+
+/**
+ * int remove_empty_frame(Algorithm_Data *data)
+ *
+ * Drop the highest numbered empty frame from a page table, renumbering the
+ * frames after it. Call before updating num_frames, which must still be
+ * the old count.
+ *
+ * @param data {Algorithm_Data*} page table to shrink
+ *
+ * @return {int} 1 if a frame was removed, 0 if none was empty
+ */
+int remove_empty_frame(Algorithm_Data *data)
+{
+        Frame *framep, *empty = NULL;
+        int i, n;
+        for (framep = data->page_table.lh_first; framep != NULL; framep = framep->frames.le_next)
+                if(framep->page == -1)
+                        empty = framep;
+        if(empty == NULL)
+                return 0;
+        for (framep = empty->frames.le_next; framep != NULL; framep = framep->frames.le_next)
+                framep->index--;
+        if(data->hand == empty)
+                data->hand = empty->frames.le_next;
+        if(data->lecar != NULL)
+        { // Off the free stack, keeping the order of the rest
+                for (i = 0, n = 0; i < data->lecar->num_free; ++i)
+                        if(data->lecar->free[i] != empty)
+                                data->lecar->free[n++] = data->lecar->free[i];
+                data->lecar->num_free = n;
+                lecar_resize(data->lecar, num_frames - 1);
+        }
+        LIST_REMOVE(empty, frames);
+        free(empty);
+        return 1;
+}
+
+/**
+ * int partition_loop()
+ *
+ * Simulate sets in parallel. Each worker process takes every
+ * partition_jobs-th set, replays the whole trace paging only refs to its
+ * sets, and sends their stats back through a pipe. Sets never share
+ * frames and each has its own random number state, so the split doesn't
+ * change the results.
+ *
+ * @return {int} 0, or 1 if a worker couldn't be started or failed
+ */
+int partition_loop()
+{
+        int (*pipes)[2] = malloc(sizeof(int[2])*partition_jobs), job, p, failed = 0, status;
+        pid_t *pids = malloc(sizeof(pid_t)*partition_jobs);
+        long stats[9];
+        size_t i = 0;
+        FILE *in;
+        fflush(stdout); // Workers mustn't inherit unwritten output
+        for (job = 0; job < partition_jobs; ++job)
+        {
+                if(pipe(pipes[job]) != 0 || (pids[job] = fork()) < 0)
+                {
+                        printf("Could not start partition worker %d\n", job);
+                        failed = 1;
+                        break;
+                }
+                if(pids[job] == 0)
+                { // Worker, simulate our sets and report
+                        FILE *out = fdopen(pipes[job][1], "w");
+                        close(pipes[job][0]);
+                        partition_job = job;
+                        simulate_refs(0, 0, max_page_calls);
+                        for (p = job; p < num_partitions; p += partition_jobs)
+                        {
+                                partition_sync(&partitions[p]);
+                                fwrite(&partitions[p].refs, sizeof(int), 1, out);
+                                for (i = 0; i < num_algos; ++i)
+                                {
+                                        Algorithm_Data *data = partitions[p].data[i];
+                                        stats[0] = data->hits;
+                                        stats[1] = data->misses;
+                                        stats[2] = data->evictions;
+                                        stats[3] = data->resident;
+                                        stats[4] = data->space_time;
+                                        stats[5] = data->prefetches;
+                                        stats[6] = data->prefetch_hits;
+                                        stats[7] = data->prefetch_wasted;
+                                        stats[8] = count_prefetch_unused(data);
+                                        fwrite(stats, sizeof(long), 9, out);
+                                }
+                        }
+                        fflush(stdout);
+                        _exit(fclose(out) != 0);
+                }
+                close(pipes[job][1]);
+        }
+        partition_jobs = job;
+        for (job = 0; job < partition_jobs; ++job)
+        { // Collect in order, later workers block on a full pipe until we get to them
+                in = fdopen(pipes[job][0], "r");
+                for (p = job; p < num_partitions; p += partition_jobs)
+                {
+                        if(fread(&partitions[p].refs, sizeof(int), 1, in) != 1)
+                                failed = 1;
+                        for (i = 0; i < num_algos; ++i)
+                        {
+                                Algorithm_Data *data = partitions[p].data[i];
+                                if(fread(stats, sizeof(long), 9, in) != 9)
+                                        failed = 1;
+                                data->hits = stats[0];
+                                data->misses = stats[1];
+                                data->evictions = stats[2];
+                                data->resident = stats[3];
+                                data->space_time = stats[4];
+                                data->prefetches = stats[5];
+                                data->prefetch_hits = stats[6];
+                                data->prefetch_wasted = stats[7];
+                                data->prefetch_unused = stats[8];
+                        }
+                        partitions[p].synced = max_page_calls; // Worker brought memory-time up to the end
+                }
+                fclose(in);
+                if(waitpid(pids[job], &status, 0) < 0 || !WIFEXITED(status) || WEXITSTATUS(status) != 0)
+                        failed = 1;
+        }
+        free(pipes);
+        free(pids);
+        if(failed)
+        {
+                printf("Partition workers failed\n");
+                return 1;
+        }
+        counter = max_page_calls; // Workers simulated every ref, just print results
+        return event_loop();
+}
+
+/**
+ * int partition_totals()
+ *
+ * Sum every partition's counts into each algorithm's own data, so the
+ * summary covers the whole memory
+ *
+ * @return 0
+ */
+int partition_totals()
+{
+        Algorithm_Data *data, *part;
+        int p;
+        size_t i = 0;
+        for (p = 0; p < num_partitions; ++p)
+                partition_sync(&partitions[p]);
+        for (i = 0; i < num_algos; ++i)
+        {
+                data = algos[i].data;
+                data->hits = data->misses = data->evictions = data->resident = 0;
+                data->prefetches = data->prefetch_hits = data->prefetch_wasted = data->prefetch_unused = 0;
+                data->space_time = 0;
+                for (p = 0; p < num_partitions; ++p)
+                {
+                        part = partitions[p].data[i];
+                        if(partition_mode == PARTITION_TENANTS || partition_jobs <= 1)
+                                part->prefetch_unused = count_prefetch_unused(part); // else a worker counted it
+                        data->hits += part->hits;
+                        data->misses += part->misses;
+                        data->evictions += part->evictions;
+                        data->resident += part->resident;
+                        data->space_time += part->space_time;
+                        data->prefetches += part->prefetches;
+                        data->prefetch_hits += part->prefetch_hits;
+                        data->prefetch_wasted += part->prefetch_wasted;
+                        data->prefetch_unused += part->prefetch_unused;
+                }
+        }
+        return 0;
+}
+
+/**
+ * int print_partitions()
+ *
+ * Print each selected algorithm's stats per partition. Mean resident is
+ * over every ref, not just the partition's.
+ *
+ * @return 0
+ */
+int print_partitions()
+{
+        Algorithm_Data *data;
+        int p;
+        size_t i = 0;
+        for (p = 0; p < num_partitions; ++p)
+        {
+                printf("%s %d, ", partition_mode == PARTITION_SETS ? "Set" : "Tenant", p);
+                printf("Soft Quota: %d, Hard Quota: %d, ", partitions[p].soft, partitions[p].hard);
+                printf("Refs: %d\n", partitions[p].refs);
+                for (i = 0; i < num_algos; ++i)
+                {
+                        if(algos[i].selected == 0)
+                                continue;
+                        data = partitions[p].data[i];
+                        printf("  %s ", algos[i].label);
+                        printf("Frames: %d, ", partitions[p].frames[i]);
+                        printf("Hits: %d, ", data->hits);
+                        printf("Misses: %d, ", data->misses);
+                        printf("Hit Ratio: %f, ", data->hits + data->misses == 0 ? 0.0 :
+                               (double)data->hits/(double)(data->hits+data->misses));
+                        printf("Evictions: %d, ", data->evictions);
+                        printf("Mean Resident: %f", counter == 0 ? 0.0 : (double)data->space_time/(double)counter);
+                        if(partition_mode == PARTITION_TENANTS)
+                                printf(", Borrowed: %d, Reclaimed: %d", partitions[p].borrowed[i], partitions[p].reclaimed[i]);
+                        printf("\n");
+                }
+        }
+        return 0;
+}
+
+/**
+ * int metrics_open()
+ *
+ * Open the metrics stream with a large buffer so rows cost a memcpy, not a
+ * write, and write the CSV header
+ *
+ * @return {int} 0, or 1 if metrics_file couldn't be opened
+ */
+int metrics_open()
+{
+        int i;
+        metrics.out = strcmp(metrics_file, "-") == 0 ? stdout :
+                      fopen(metrics_file, metrics_format == METRICS_BIN ? "wb" : "w");
+        if(metrics.out == NULL)
+        {
+                printf("Could not open metrics %s\n", metrics_file);
+                return 1;
+        }
+        if(metrics.out != stdout)
+                setvbuf(metrics.out, NULL, _IOFBF, 1 << 20);
+        metrics.last_hits = calloc(num_algos, sizeof(int));
+        metrics.last_misses = calloc(num_algos, sizeof(int));
+        metrics.last_evictions = calloc(num_algos, sizeof(int));
+        metrics.capacity = 4096;
+        metrics.rows = 0;
+        for (i = 0; i < METRIC_COLUMNS; ++i)
+                metrics.columns[i] = malloc(sizeof(int)*metrics.capacity);
+        if(metrics_format == METRICS_CSV)
+                fprintf(metrics.out, "ref,frames,algorithm,refs,hits,misses,hit_ratio,fault_rate,evictions,resident\n");
+        else
+                fwrite("PGSIMMT1", 1, 8, metrics.out);
+        return 0;
+}
+
+/**
+ * int metrics_start()
+ *
+ * Start a window at the current ref from every algorithm's current counts
+ *
+ * @return 0
+ */
+int metrics_start()
+{
+        size_t i = 0;
+        metrics.window_start = counter;
+        for (i = 0; i < num_algos; i++)
+        {
+                metrics.last_hits[i] = algos[i].data->hits;
+                metrics.last_misses[i] = algos[i].data->misses;
+                metrics.last_evictions[i] = algos[i].data->evictions;
+        }
+        return 0;
+}
+
+/**
+ * int metrics_window()
+ *
+ * Emit a row per selected algorithm for the window ending at the current
+ * ref and start the next window
+ *
+ * @return 0
+ */
+int metrics_window()
+{
+        int row[METRIC_COLUMNS], c;
+        size_t i = 0;
+        for (i = 0; i < num_algos; i++)
+        {
+                if(algos[i].selected == 0)
+                        continue;
+                row[METRIC_REF] = counter;
+                row[METRIC_FRAMES] = num_frames;
+                row[METRIC_ALGO] = i;
+                row[METRIC_REFS] = counter - metrics.window_start;
+                row[METRIC_HITS] = algos[i].data->hits - metrics.last_hits[i];
+                row[METRIC_MISSES] = algos[i].data->misses - metrics.last_misses[i];
+                row[METRIC_EVICTIONS] = algos[i].data->evictions - metrics.last_evictions[i];
+                row[METRIC_RESIDENT] = algos[i].data->resident;
+                if(metrics_format == METRICS_CSV)
+                {
+                        fprintf(metrics.out, "%d,%d,%s,%d,%d,%d,%f,%f,%d,%d\n", row[METRIC_REF], row[METRIC_FRAMES],
+                                algos[i].label, row[METRIC_REFS], row[METRIC_HITS], row[METRIC_MISSES],
+                                (double)row[METRIC_HITS]/(double)row[METRIC_REFS],
+                                (double)row[METRIC_MISSES]/(double)row[METRIC_REFS],
+                                row[METRIC_EVICTIONS], row[METRIC_RESIDENT]);
+                        continue;
+                }
+                for (c = 0; c < METRIC_COLUMNS; ++c)
+                        metrics.columns[c][metrics.rows] = row[c];
+                if(++metrics.rows == metrics.capacity)
+                        metrics_flush();
+        }
+        metrics_start();
+        return 0;
+}
+
+/**
+ * int metrics_flush()
+ *
+ * Write buffered binary rows as a block: the row count, then each column's
+ * values for every row in Metric_Column order
+ *
+ * @return 0
+ */
+int metrics_flush()
+{
+        int c;
+        if(metrics.rows == 0)
+                return 0;
+        fwrite(&metrics.rows, sizeof(int), 1, metrics.out);
+        for (c = 0; c < METRIC_COLUMNS; ++c)
+                fwrite(metrics.columns[c], sizeof(int), metrics.rows, metrics.out);
+        metrics.rows = 0;
+        return 0;
+}
+
+/**
+ * int metrics_close()
+ *
+ * Write any buffered rows, close the stream and free its buffers
+ *
+ * @return 0
+ */
+int metrics_close()
+{
+        int c;
+        if(metrics_format == METRICS_BIN)
+                metrics_flush();
+        if(metrics.out == stdout)
+                fflush(stdout);
+        else
+                fclose(metrics.out);
+        metrics.out = NULL;
+        free(metrics.last_hits);
+        free(metrics.last_misses);
+        free(metrics.last_evictions);
+        for (c = 0; c < METRIC_COLUMNS; ++c)
+                free(metrics.columns[c]);
+        return 0;
+}
+
+/**
+ * int prefetch_detect(int page_ref)
+ *
+ * Update stream detection with a demand ref and pick the pages to prefetch
+ * if any algorithm triggers readahead on it
+ *
+ * @param page_ref {int} page being referenced
+ *
+ * @return {int} number of prefetch candidates
+ */
+int prefetch_detect(int page_ref)
+{
+        int i, stride = page_ref - prefetcher.last_ref;
+        prefetcher.num_candidates = 0;
+        if(prefetcher.last_ref > -1 && stride != 0 && stride == prefetcher.stride)
+                prefetcher.run++;
+        else
+                prefetcher.run = 0;
+        if(prefetcher.last_ref > -1)
+                prefetcher.stride = stride;
+        prefetcher.last_ref = page_ref;
+        switch(prefetch_mode)
+        {
+        case PREFETCH_SEQ:
+                if(prefetcher.stride == 1 && prefetcher.run > 0)
+                        stride = 1;
+                else
+                        stride = 0;
+                break;
+        case PREFETCH_STRIDE:
+                if(prefetcher.stride != 0 && prefetcher.run > 0)
+                        stride = prefetcher.stride;
+                else
+                        stride = 0;
+                break;
+        case PREFETCH_CLUSTER:
+                for(i = page_ref - page_ref % prefetch_window; i < page_ref - page_ref % prefetch_window + prefetch_window; ++i)
+                        if(i != page_ref && i < page_ref_upper_bound)
+                                prefetcher.candidates[prefetcher.num_candidates++] = i;
+                return prefetcher.num_candidates;
+        default:
+                return 0;
+        }
+        for(i = 1; stride != 0 && i <= prefetch_window; ++i)
+        { // readahead along the detected stream, stop at the end of the address space
+                if(page_ref + i*stride < 0 || page_ref + i*stride >= page_ref_upper_bound)
+                        break;
+                prefetcher.candidates[prefetcher.num_candidates++] = page_ref + i*stride;
+        }
+        return prefetcher.num_candidates;
+}
+
+/**
+ * int prefetch_check(Algorithm_Data *data, int page_ref)
+ *
+ * Prefetch accounting before an algorithm sees a demand ref. Counts refs to
+ * prefetched pages, and with low priority evicts the oldest unused prefetched
+ * page ahead of the algorithm's own victim when the ref will fault.
+ *
+ * @param data {Algorithm_Data} algorithm about to be paged
+ * @param page_ref {int} page being referenced
+ *
+ * @return {int} 1 if ref hit a prefetched page and readahead should continue, else 0
+ */
+int prefetch_check(Algorithm_Data *data, int page_ref)
+{
+        Frame *framep = find_frame(data, page_ref),
+              *victim = NULL;
+        if(framep != NULL)
+        {
+                if(framep->prefetched == -1)
+                        return 0;
+                data->prefetch_hits++;
+                framep->prefetched = -1;
+                return 1;
+        }
+        if(prefetch_priority == 1)
+                return 0;
+        for (framep = data->page_table.lh_first; framep != NULL; framep = framep->frames.le_next)
+        {
+                if(framep->page == -1)
+                        return 0; // Free frame, nothing needs evicting
+                if(framep->prefetched > -1 && (victim == NULL || framep->prefetched < victim->prefetched))
+                        victim = framep;
+        }
+        if(victim != NULL)
+        {
+                add_victim(data, victim);
+                victim->page = -1;
+        }
+        return 0;
+}
+
+/**
+ * int prefetch_issue(Algorithm *algo)
+ *
+ * Bring the prefetch candidates into an algorithm's page table. Pages are
+ * inserted through the algorithm itself so it picks its own victims, but
+ * don't count as hits or misses. prefetching is set meanwhile, so no
+ * algorithm takes the insert for a demand fault: PFF keeps its R bits and
+ * fault time, WS releases nothing and LECAR doesn't learn from ghosts.
+ *
+ * @param algo {Algorithm*} algorithm to prefetch into
+ *
+ * @return {int} number of pages prefetched
+ */
+int prefetch_issue(Algorithm *algo)
+{
+        int i, issued = 0, page_ref = last_page_ref;
+        Frame *framep;
+        for(i = 0; i < prefetcher.num_candidates && issued < num_frames - 1; ++i)
+        {
+                if(find_frame(algo->data, prefetcher.candidates[i]) != NULL)
+                        continue; // Already resident
+                last_page_ref = prefetcher.candidates[i];
+                prefetching = 1;
+                algo->algo(algo->data);
+                prefetching = 0;
+                page_in(algo->data, last_page_ref);
+                framep = find_frame(algo->data, last_page_ref);
+                if(framep != NULL)
+                        framep->prefetched = counter;
+                algo->data->prefetches++;
+                issued++;
+        }
+        last_page_ref = page_ref;
+        return issued;
+}
+
+/**
+ * int count_prefetch_unused(Algorithm_Data *data)
+ *
+ * Count prefetched pages still resident and not yet referenced, the
+ * prefetches that are neither useful nor wasted when the run ends
+ *
+ * @param data {Algorithm_Data} algorithm's page table
+ *
+ * @return {int} unreferenced prefetched pages in page_table
+ */
+int count_prefetch_unused(Algorithm_Data *data)
+{
+        Frame *framep;
+        int unused = 0;
+        for (framep = data->page_table.lh_first; framep != NULL; framep = framep->frames.le_next)
+                if(framep->page > -1 && framep->prefetched > -1)
+                        unused++;
+        return unused;
+}
+
+/**
+ * Tlb* create_tlb()
+ *
+ * Creates an empty TLB with the configured geometry for an Algorithm
+ *
+ * @return {Tlb*} empty TLB
+ */
+Tlb *create_tlb()
+{
+        int i, regions = (page_ref_upper_bound >> 9) + 1;
+        Tlb *tlb = malloc(sizeof(Tlb));
+        for (i = PAGE_4K; i <= PAGE_1G; ++i)
+                tlb_level_init(&tlb->l1[i], tlb_l1_entries[i], tlb_l1_ways[i]);
+        tlb_level_init(&tlb->l2, tlb_l2_entries, tlb_l2_ways);
+        tlb->tick = 0;
+        tlb->walks = 0;
+        tlb->promotions = 0;
+        tlb->demotions = 0;
+        tlb->region_pages = calloc(regions, sizeof(int));
+        tlb->region_huge = calloc(regions, sizeof(char));
+        return tlb;
+}
+
+/**
+ * int tlb_level_init(Tlb_Level *level, int entries, int ways)
+ *
+ * Allocate an empty set associative TLB level
+ *
+ * @param level {Tlb_Level*} level to init
+ * @param entries {int} total entries, a multiple of ways
+ * @param ways {int} entries per set
+ *
+ * @return 0
+ */
+int tlb_level_init(Tlb_Level *level, int entries, int ways)
+{
+        int i;
+        level->entries = entries;
+        level->ways = ways;
+        level->sets = entries / ways;
+        level->tags = malloc(sizeof(long)*entries);
+        level->used = malloc(sizeof(int)*entries);
+        for (i = 0; i < entries; ++i)
+        {
+                level->tags[i] = -1;
+                level->used[i] = 0;
+        }
+        level->hits = 0;
+        level->misses = 0;
+        return 0;
+}
+
+/**
+ * int tlb_level_lookup(Tlb_Level *level, long tag, int tick)
+ *
+ * Look up a translation in a TLB level, filling the LRU way of its set on a miss
+ *
+ * @param level {Tlb_Level*} level to search
+ * @param tag {long} translation tag, (vpn << 2 | Page_Size)
+ * @param tick {int} lookup time for LRU
+ *
+ * @return {int} 1 on hit, 0 on miss
+ */
+int tlb_level_lookup(Tlb_Level *level, long tag, int tick)
+{
+        int i, set = (int)((tag >> 2) % level->sets) * level->ways,
+            victim = set;
+        for (i = set; i < set + level->ways; ++i)
+        {
+                if(level->tags[i] == tag)
+                {
+                        level->used[i] = tick;
+                        level->hits++;
+                        return 1;
+                }
+                if(level->tags[victim] != -1 && (level->tags[i] == -1 || level->used[i] < level->used[victim]))
+                        victim = i; // Empty way or way used longer ago
+        }
+        level->tags[victim] = tag;
+        level->used[victim] = tick;
+        level->misses++;
+        return 0;
+}
+
+/**
+ * int tlb_level_invalidate(Tlb_Level *level, long tag)
+ *
+ * Drop a translation from a TLB level
+ *
+ * @param level {Tlb_Level*} level to search
+ * @param tag {long} translation tag, (vpn << 2 | Page_Size)
+ *
+ * @return {int} 1 if translation was cached, else 0
+ */
+int tlb_level_invalidate(Tlb_Level *level, long tag)
+{
+        int i, set = (int)((tag >> 2) % level->sets) * level->ways;
+        for (i = set; i < set + level->ways; ++i)
+        {
+                if(level->tags[i] == tag)
+                {
+                        level->tags[i] = -1;
+                        return 1;
+                }
+        }
+        return 0;
+}
+
+/**
+ * int tlb_page_size(Tlb *tlb, int page_ref)
+ *
+ * Find the size of the translation currently mapping a page
+ *
+ * @param tlb {Tlb*} TLB holding huge page state
+ * @param page_ref {int} base page
+ *
+ * @return {int} Page_Size of mapping
+ */
+int tlb_page_size(Tlb *tlb, int page_ref)
+{
+        switch(hugepages)
+        {
+        case HUGEPAGES_1G:
+                return PAGE_1G;
+        case HUGEPAGES_2M:
+                return PAGE_2M;
+        case HUGEPAGES_THP:
+                return tlb->region_huge[page_ref >> 9] ? PAGE_2M : PAGE_4K;
+        default:
+                return PAGE_4K;
+        }
+}
+
+/**
+ * int tlb_translate(Tlb *tlb, int page_ref, int fault)
+ *
+ * Translate a demand ref through the first level for its page size, then
+ * the unified second level, then walk the page table. Levels are filled on
+ * the way back. A faulting ref's page wasn't present, so no translation
+ * for it can be cached and it always walks.
+ *
+ * @param tlb {Tlb*} TLB to translate with
+ * @param page_ref {int} base page
+ * @param fault {int} 1 if the ref page faulted
+ *
+ * @return {int} 1 if translation needed a page table walk, else 0
+ */
+int tlb_translate(Tlb *tlb, int page_ref, int fault)
+{
+        int size = tlb_page_size(tlb, page_ref);
+        long tag = ((long)(page_ref >> (9*size)) << 2) | size;
+        tlb->tick++;
+        if(fault == 1)
+        { // Stale translation of a huge page covering the faulting page
+                tlb_level_invalidate(&tlb->l1[size], tag);
+                tlb_level_invalidate(&tlb->l2, tag);
+        }
+        if(tlb_level_lookup(&tlb->l1[size], tag, tlb->tick))
+                return 0;
+        if(tlb_level_lookup(&tlb->l2, tag, tlb->tick))
+                return 0;
+        tlb->walks++;
+        return 1;
+}
+
+/**
+ * int tlb_map(Tlb *tlb, int page_ref)
+ *
+ * Record a page becoming resident. With THP a 2M region is collapsed into a
+ * huge page once thp_threshold of its base pages are resident, dropping the
+ * base page translations it replaces.
+ *
+ * @param tlb {Tlb*} TLB holding huge page state
+ * @param page_ref {int} base page made resident
+ *
+ * @return {int} 1 if region was promoted, else 0
+ */
+int tlb_map(Tlb *tlb, int page_ref)
+{
+        int i, region = page_ref >> 9;
+        tlb->region_pages[region]++;
+        if(hugepages != HUGEPAGES_THP || tlb->region_huge[region] || tlb->region_pages[region] < thp_threshold)
+                return 0;
+        tlb->region_huge[region] = 1;
+        tlb->promotions++;
+        for (i = 0; i < tlb->l1[PAGE_4K].entries; ++i)
+                if(tlb->l1[PAGE_4K].tags[i] != -1 && tlb->l1[PAGE_4K].tags[i] >> 11 == region)
+                        tlb->l1[PAGE_4K].tags[i] = -1;
+        for (i = 0; i < tlb->l2.entries; ++i)
+                if(tlb->l2.tags[i] != -1 && (tlb->l2.tags[i] & 3) == PAGE_4K && tlb->l2.tags[i] >> 11 == region)
+                        tlb->l2.tags[i] = -1;
+        return 1;
+}
+
+/**
+ * int tlb_unmap(Tlb *tlb, int page_ref)
+ *
+ * Record a page being evicted, shooting down its translation and any huge
+ * page translation covering it. A THP huge page covering it is split back
+ * into base pages.
+ *
+ * @param tlb {Tlb*} TLB holding huge page state
+ * @param page_ref {int} base page evicted
+ *
+ * @return {int} 1 if a huge page was split, else 0
+ */
+int tlb_unmap(Tlb *tlb, int page_ref)
+{
+        int region = page_ref >> 9, size;
+        long tag = ((long)page_ref << 2) | PAGE_4K;
+        if(page_ref < 0)
+                return 0;
+        tlb->region_pages[region]--;
+        tlb_level_invalidate(&tlb->l1[PAGE_4K], tag);
+        tlb_level_invalidate(&tlb->l2, tag);
+        if(hugepages == HUGEPAGES_2M || hugepages == HUGEPAGES_1G)
+        { // Static huge page stays mapped, but its cached translation is stale
+                size = tlb_page_size(tlb, page_ref);
+                tag = ((long)(page_ref >> (9*size)) << 2) | size;
+                tlb_level_invalidate(&tlb->l1[size], tag);
+                tlb_level_invalidate(&tlb->l2, tag);
+        }
+        if(hugepages != HUGEPAGES_THP || !tlb->region_huge[region])
+                return 0;
+        tag = ((long)region << 2) | PAGE_2M;
+        tlb_level_invalidate(&tlb->l1[PAGE_2M], tag);
+        tlb_level_invalidate(&tlb->l2, tag);
+        tlb->region_huge[region] = 0;
+        tlb->demotions++;
+        return 1;
+}
+
+/**
+ * void free_tlb(Tlb *tlb)
+ *
+ * Free a TLB and its levels
+ *
+ * @param tlb {Tlb*} TLB to free
+ */
+void free_tlb(Tlb *tlb)
+{
+        int i;
+        for (i = PAGE_4K; i <= PAGE_1G; ++i)
+        {
+                free(tlb->l1[i].tags);
+                free(tlb->l1[i].used);
+        }
+        free(tlb->l2.tags);
+        free(tlb->l2.used);
+        free(tlb->region_pages);
+        free(tlb->region_huge);
+        free(tlb);
+}
+
+/**
+ * Zswap* create_zswap()
+ *
+ * Creates an empty compressed pool for an Algorithm
+ *
+ * @return {Zswap*} empty pool
+ */
+Zswap *create_zswap()
+{
+        Zswap *zswap = malloc(sizeof(Zswap));
+        TAILQ_INIT(&zswap->lru);
+        zswap->pages = calloc(page_ref_upper_bound, sizeof(Zswap_Entry*));
+        zswap->swapped = calloc(page_ref_upper_bound, sizeof(char));
+        zswap->used = 0;
+        zswap->stores = 0;
+        zswap->rejects = 0;
+        zswap->loads = 0;
+        zswap->writebacks = 0;
+        zswap->swapins = 0;
+        zswap->cpu_us = 0;
+        zswap->io_us = 0;
+        return zswap;
+}
+
+/**
+ * float page_ratio(int page_ref)
+ *
+ * Compression ratio of a page, from the trace if it gave one, else drawn
+ * uniformly from zswap_ratio_min to zswap_ratio_max by hashing the page
+ * number, so turning zswap on doesn't shift the random number sequence
+ *
+ * @param page_ref {int} page
+ *
+ * @return {float} uncompressed size / compressed size
+ */
+float page_ratio(int page_ref)
+{
+        if(page_ratios[page_ref] == 0)
+                page_ratios[page_ref] = zswap_ratio_min + (zswap_ratio_max - zswap_ratio_min)
+                                        * (float)((double)(hash64(~(unsigned long long)page_ref) >> 11) / 9007199254740992.0);
+        return page_ratios[page_ref];
+}
+
+/**
+ * int zswap_store(Zswap *zswap, int page_ref)
  *
- * Generate all page refs to use in tests
+ * Compress an evicted page into the pool. Pages that don't compress below a
+ * page go straight to swap. When the pool is full the LRU pool pages are
+ * written back to swap to make room, or with writeback off the new page is
+ * sent to swap instead.
  *
- * @return 0
+ * @param zswap {Zswap*} pool to store into
+ * @param page_ref {int} evicted page
+ *
+ * @return {int} 1 if page was stored in pool, 0 if it went to swap
  */
-void gen_page_refs()
+int zswap_store(Zswap *zswap, int page_ref)
 {
-        num_refs = 0;
-        LIST_INIT(&page_refs);
-        Page_Ref *page = gen_ref();
-        LIST_INSERT_HEAD(&page_refs, page, pages);
-        while(num_refs < max_page_calls)
-        { // generate a page ref up too  max_page_calls and add to list
-                LIST_INSERT_AFTER(page, gen_ref(), pages);
-                page = page->pages.le_next;
-                num_refs++;
-        }
-        // we need look-ahead for Optimal algorithm
-        int all_found = 0;
-        optimum_find_test = (int*)malloc(page_ref_upper_bound*sizeof(int));
-        size_t i;
-        for(i = 0; i < page_ref_upper_bound; ++i)
-        { // generate new refs until one of each have been added to list
-                optimum_find_test[i] = -1;
+        Zswap_Entry *entry;
+        int size;
+        if(page_ref < 0)
+                return 0;
+        size = (int)(4096 / page_ratio(page_ref));
+        if(size < 1)
+                size = 1;
+        if(size >= 4096 || size > zswap_capacity || (zswap_writeback == 0 && zswap->used + size > zswap_capacity))
+        { // Incompressible, or no room and not allowed to make some
+                if(size >= 4096)
+                        zswap->cpu_us += zswap_compress_us;
+                zswap->rejects++;
+                zswap->swapped[page_ref] = 1;
+                zswap->io_us += swap_write_us;
+                return 0;
         }
-        while(all_found == 0)
-        { // generate new refs until one of each have been added to list
-                LIST_INSERT_AFTER(page, gen_ref(), pages);
-                page = page->pages.le_next;
-                optimum_find_test[page->page_num] = 1;
-                all_found = 1;
-                for(i = 0; i < page_ref_upper_bound; ++i)
-                { // see if we've got them all yet
-                        if(optimum_find_test[i] == -1)
-                        {
-                                all_found = 0;
-                                break;
-                        }
-                }
-                num_refs++;
+        while(zswap->used + size > zswap_capacity)
+        { // Write back LRU pool pages until new page fits
+                entry = TAILQ_LAST(&zswap->lru, Zswap_List);
+                TAILQ_REMOVE(&zswap->lru, entry, entries);
+                zswap->pages[entry->page] = NULL;
+                zswap->swapped[entry->page] = 1;
+                zswap->used -= entry->size;
+                zswap->writebacks++;
+                zswap->io_us += swap_write_us;
+                free(entry);
         }
-        return;
+        entry = malloc(sizeof(Zswap_Entry));
+        entry->page = page_ref;
+        entry->size = size;
+        TAILQ_INSERT_HEAD(&zswap->lru, entry, entries);
+        zswap->pages[page_ref] = entry;
+        zswap->used += size;
+        zswap->stores++;
+        zswap->cpu_us += zswap_compress_us;
+        return 1;
 }
 
 /**
- * Page_Ref* gen_ref()
+ * int zswap_load(Zswap *zswap, int page_ref)
  *
- * generate a random page ref within bounds
+ * Bring a faulting page back, decompressing it out of the pool or reading
+ * it from swap. Pages never evicted cost nothing.
  *
- * @return {Page_Ref*}
+ * @param zswap {Zswap*} pool to load from
+ * @param page_ref {int} faulting page
+ *
+ * @return {int} 1 if page came from pool, 0 otherwise
  */
-Page_Ref* gen_ref()
+int zswap_load(Zswap *zswap, int page_ref)
 {
-        Page_Ref *page = malloc(sizeof(Page_Ref));
-        page->page_num = rand() % page_ref_upper_bound;
-        return page;
+        Zswap_Entry *entry = zswap->pages[page_ref];
+        if(entry == NULL)
+        {
+                if(zswap->swapped[page_ref])
+                {
+                        zswap->swapped[page_ref] = 0;
+                        zswap->swapins++;
+                        zswap->io_us += swap_read_us;
+                }
+                return 0;
+        }
+        TAILQ_REMOVE(&zswap->lru, entry, entries);
+        zswap->pages[page_ref] = NULL;
+        zswap->used -= entry->size;
+        zswap->loads++;
+        zswap->cpu_us += zswap_decompress_us;
+        free(entry);
+        return 1;
 }
 
 /**
- * Algorithm_Data* create_algo_data_store(int num_frames)
+ * void free_zswap(Zswap *zswap)
  *
- * Creates an empty Algorithm_Data to init an Algorithm
+ * Free a compressed pool and its entries
  *
- * @return {Algorithm_Data*} empty Algorithm_Data struct for an Algorithm
+ * @param zswap {Zswap*} pool to free
  */
-Algorithm_Data *create_algo_data_store()
+void free_zswap(Zswap *zswap)
 {
-        Algorithm_Data *data = malloc(sizeof(Algorithm_Data));
-        data->hits = 0;
-        data->misses = 0;
-        data->last_victim = NULL;
-        /* Initialize Lists */
-        LIST_INIT(&(data->page_table));
-        LIST_INIT(&(data->victim_list));
-        /* Insert at the page_table. */
-        Frame *framep = create_empty_frame(0);
-        LIST_INSERT_HEAD(&(data->page_table), framep, frames);
-        /* Build the rest of the list. */
-        size_t i = 0;
-        for (i = 1; i < num_frames; ++i)
+        Zswap_Entry *entry;
+        while((entry = zswap->lru.tqh_first) != NULL)
         {
-                LIST_INSERT_AFTER(framep, create_empty_frame(i), frames);
-                framep = framep->frames.le_next;
+                TAILQ_REMOVE(&zswap->lru, entry, entries);
+                free(entry);
         }
-        return data;
+        free(zswap->pages);
+        free(zswap->swapped);
+        free(zswap);
 }
 
 /**
- * Frame* create_empty_frame(int num_frames)
+ * Lecar* create_lecar(Algorithm_Data *data)
  *
- * Creates an empty Frame for page table list
+ * Creates LECAR state for an algorithm's page table, every frame empty
  *
- * @return {Frame*} empty Frame entry for page table list
+ * @param data {Algorithm_Data} algorithm LECAR manages
+ *
+ * @return {Lecar*} LECAR state with equal expert weights
  */
-Frame* create_empty_frame(int index)
+Lecar *create_lecar(Algorithm_Data *data)
 {
-        Frame *framep = malloc(sizeof(Frame));
-        framep->index = index;
-        framep->page = -1;
-        time(&framep->time);
-        framep->extra = 0;
-        return framep;
+        Lecar *lecar = malloc(sizeof(Lecar));
+        Frame *framep;
+        int i;
+        lecar->pages = calloc(page_ref_upper_bound, sizeof(Lecar_Entry*));
+        TAILQ_INIT(&lecar->lru);
+        TAILQ_INIT(&lecar->lfu);
+        lecar->free = malloc(sizeof(Frame*)*num_frames);
+        lecar->num_free = 0;
+        for (framep = data->page_table.lh_first; framep != NULL; framep = framep->frames.le_next)
+                lecar->free[num_frames - 1 - lecar->num_free++] = framep; // first frame on top
+        lecar->ghost = calloc(page_ref_upper_bound, sizeof(char));
+        lecar->ghost_slot = calloc(page_ref_upper_bound, sizeof(int));
+        lecar->ghost_time = calloc(page_ref_upper_bound, sizeof(int));
+        for (i = EXPERT_LRU; i <= EXPERT_LFU; ++i)
+        {
+                lecar->history[i] = malloc(sizeof(int)*num_frames);
+                memset(lecar->history[i], -1, sizeof(int)*num_frames);
+                lecar->history_pos[i] = 0;
+                lecar->weight[i] = 0.5;
+        }
+        lecar->discount = pow(0.005, 1.0/num_frames);
+        return lecar;
 }
 
 /**
- * int event_loop()
+ * int lecar_set_bucket(Lecar *lecar, Lecar_Entry *entry, int freq)
  *
- * page all selected algorithms with input ref
+ * Move a page to the head of the bucket for freq, creating the bucket if
+ * needed and dropping the page's old bucket once empty. freq must be 1 for
+ * a page that has no bucket yet or one more than its current freq, so the
+ * bucket is always at or next to the old one.
  *
- * @param page_ref {int} page to ref
+ * @param lecar {Lecar*} LECAR state
+ * @param entry {Lecar_Entry*} page to move
+ * @param freq {int} page's new frequency
  *
  * @return 0
  */
-int event_loop()
+int lecar_set_bucket(Lecar *lecar, Lecar_Entry *entry, int freq)
 {
-        counter = 0;
-        while(counter < max_page_calls)
+        Lecar_Bucket *prev = entry->bucket,
+                     *bucket = prev == NULL ? TAILQ_FIRST(&lecar->lfu) : TAILQ_NEXT(prev, buckets);
+        if(bucket == NULL || bucket->freq != freq)
         {
-                page(get_ref());
-                ++counter;
+                bucket = malloc(sizeof(Lecar_Bucket));
+                bucket->freq = freq;
+                TAILQ_INIT(&bucket->entries);
+                if(prev == NULL)
+                        TAILQ_INSERT_HEAD(&lecar->lfu, bucket, buckets);
+                else
+                        TAILQ_INSERT_AFTER(&lecar->lfu, prev, bucket, buckets);
         }
-        size_t i = 0;
-        for (i = 0; i < num_algos; i++)
+        if(prev != NULL)
         {
-                if(algos[i].selected==1) {
-                        print_summary(algos[i]);
+                TAILQ_REMOVE(&prev->entries, entry, frequency);
+                if(TAILQ_EMPTY(&prev->entries))
+                {
+                        TAILQ_REMOVE(&lecar->lfu, prev, buckets);
+                        free(prev);
                 }
         }
+        TAILQ_INSERT_HEAD(&bucket->entries, entry, frequency);
+        entry->bucket = bucket;
         return 0;
 }
 
 /**
- * int get_ref()
+ * int lecar_remember(Lecar *lecar, int expert, int page_ref)
  *
- * get a random ref
+ * Add a page to an expert's ghost list, overwriting the oldest ghost once
+ * the list holds num_frames pages
  *
- * @return {int}
+ * @param lecar {Lecar*} LECAR state
+ * @param expert {int} Lecar_Expert that picked page as victim
+ * @param page_ref {int} page evicted
+ *
+ * @return 0
  */
-int get_ref()
+int lecar_remember(Lecar *lecar, int expert, int page_ref)
 {
-        if (page_refs.lh_first != NULL)
-        { // pop Page_Ref off page_refs
-                int page_num = page_refs.lh_first->page_num;
-                LIST_REMOVE(page_refs.lh_first, pages);
-                return page_num;
-        }
-        else
-        { // just in case
-                return rand() % page_ref_upper_bound;
+        int slot = lecar->history_pos[expert],
+            old = lecar->history[expert][slot];
+        if(old > -1 && lecar->ghost[old] == expert + 1 && lecar->ghost_slot[old] == slot)
+                lecar->ghost[old] = 0; // Fell off the end of the ghost list
+        lecar->history[expert][slot] = page_ref;
+        lecar->ghost[page_ref] = expert + 1;
+        lecar->ghost_slot[page_ref] = slot;
+        lecar->ghost_time[page_ref] = counter;
+        lecar->history_pos[expert] = (slot + 1) % num_frames;
+        return 0;
+}
+
+/**
+ * int lecar_forget(Lecar *lecar, Frame *frame)
+ *
+ * Drop an evicted page from LECAR's recency and frequency orders and put
+ * its frame on the free stack. Called from add_victim() so pages evicted
+ * outside LECAR, e.g. by the prefetcher, are dropped too.
+ *
+ * @param lecar {Lecar*} LECAR state
+ * @param frame {Frame*} frame being evicted
+ *
+ * @return {int} 1 if page was resident, else 0
+ */
+int lecar_forget(Lecar *lecar, Frame *frame)
+{
+        Lecar_Entry *entry;
+        Lecar_Bucket *bucket;
+        if(frame->page < 0 || (entry = lecar->pages[frame->page]) == NULL)
+                return 0;
+        bucket = entry->bucket;
+        TAILQ_REMOVE(&lecar->lru, entry, recency);
+        TAILQ_REMOVE(&bucket->entries, entry, frequency);
+        if(TAILQ_EMPTY(&bucket->entries))
+        {
+                TAILQ_REMOVE(&lecar->lfu, bucket, buckets);
+                free(bucket);
         }
+        lecar->pages[frame->page] = NULL;
+        lecar->free[lecar->num_free++] = frame;
+        free(entry);
+        return 1;
 }
 
 /**
- * int page()
+ * int lecar_check(Algorithm_Data *data)
  *
- * page all selected algorithms with input ref
+ * Walk LECAR's state and print its size, or the first inconsistency found.
+ * Every resident page must have an entry in the recency order and in the
+ * bucket for its frequency, buckets must ascend and never be empty, the
+ * free stack must hold the other frames, and every ghost page must be out
+ * of memory and in its expert's history ring at the slot it records.
  *
- * @param page_ref {int} page to ref
+ * @param data {Algorithm_Data} LECAR's page table and state
  *
- * @return 0
+ * @return {int} 0 if consistent, else 1
  */
-int page(int page_ref)
+int lecar_check(Algorithm_Data *data)
 {
-        last_page_ref = page_ref;
-        size_t i = 0;
-        for (i = 0; i < num_algos; i++)
+        Lecar *lecar = data->lecar;
+        Lecar_Entry *entry;
+        Lecar_Bucket *bucket;
+        Frame *framep;
+        const char *error = NULL;
+        int resident = 0, listed = 0, bucketed = 0, buckets = 0, freq = 0, ghosts[2] = {0, 0}, page_ref, expert;
+        for (framep = data->page_table.lh_first; framep != NULL; framep = framep->frames.le_next)
         {
-                if(algos[i].selected==1) {
-                        algos[i].algo(algos[i].data);
-                        if(printrefs == 1)
-                        {
-                                print_stats(algos[i]);
-                        }
+                if(framep->page == -1)
+                        continue;
+                resident++;
+                if(lecar->pages[framep->page] == NULL || lecar->pages[framep->page]->frame != framep)
+                        error = "resident page without its entry";
+        }
+        for (entry = TAILQ_FIRST(&lecar->lru); entry != NULL; entry = TAILQ_NEXT(entry, recency))
+                listed++;
+        for (bucket = TAILQ_FIRST(&lecar->lfu); bucket != NULL; bucket = TAILQ_NEXT(bucket, buckets))
+        {
+                if(bucket->freq <= freq || TAILQ_EMPTY(&bucket->entries))
+                        error = "frequency buckets empty or out of order";
+                freq = bucket->freq;
+                buckets++;
+                for (entry = TAILQ_FIRST(&bucket->entries); entry != NULL; entry = TAILQ_NEXT(entry, frequency))
+                {
+                        bucketed++;
+                        if(entry->bucket != bucket)
+                                error = "entry in a bucket it doesn't point to";
                 }
         }
-
+        if(listed != resident || bucketed != resident)
+                error = "recency or frequency order doesn't hold every resident page";
+        if(resident + lecar->num_free != num_frames)
+                error = "free stack and resident pages don't add up to the frames";
+        for (page_ref = 0; page_ref < page_ref_upper_bound; ++page_ref)
+        {
+                if(lecar->ghost[page_ref] == 0)
+                        continue;
+                expert = lecar->ghost[page_ref] - 1;
+                ghosts[expert]++;
+                if(lecar->pages[page_ref] != NULL)
+                        error = "resident page in a ghost list";
+                else if(lecar->ghost_slot[page_ref] >= num_frames || lecar->history[expert][lecar->ghost_slot[page_ref]] != page_ref)
+                        error = "ghost page missing from its history ring";
+        }
+        if(error != NULL)
+        {
+                printf("LECAR State Inconsistent: %s\n", error);
+                return 1;
+        }
+        printf("LECAR State: Resident %d, Buckets %d, Ghosts LRU %d, LFU %d\n", resident, buckets, ghosts[EXPERT_LRU], ghosts[EXPERT_LFU]);
         return 0;
 }
 
 /**
- * int add_victim(struct Frame_List *victim_list, struct Frame *frame)
- *
- * Add victim frame evicted from page table to list of victims
+ * void free_lecar(Lecar *lecar)
  *
- * @param index {Frame_List} list of victims
- * @param page {Frame} page frame evicted
+ * Free LECAR state, its entries and buckets
  *
- * @retun 0
+ * @param lecar {Lecar*} LECAR state to free
  */
-int add_victim(struct Frame_List *victim_list, struct Frame *frame)
+void free_lecar(Lecar *lecar)
 {
-        if(debug)
-                printf("Victim index: %d, Page: %d\n", frame->index, frame->page);
-        struct Frame *victim = malloc(sizeof(Frame));
-        *victim = *frame;
-        victim->index = 1;
-        LIST_INSERT_HEAD(victim_list, victim, frames);
-        return 0;
+        Lecar_Entry *entry;
+        Lecar_Bucket *bucket;
+        while((entry = TAILQ_FIRST(&lecar->lru)) != NULL)
+        {
+                TAILQ_REMOVE(&lecar->lru, entry, recency);
+                free(entry);
+        }
+        while((bucket = TAILQ_FIRST(&lecar->lfu)) != NULL)
+        {
+                TAILQ_REMOVE(&lecar->lfu, bucket, buckets);
+                free(bucket);
+        }
+        free(lecar->pages);
+        free(lecar->free);
+        free(lecar->ghost);
+        free(lecar->ghost_slot);
+        free(lecar->ghost_time);
+        free(lecar->history[EXPERT_LRU]);
+        free(lecar->history[EXPERT_LFU]);
+        free(lecar);
 }
 
 /**
  * int OPTIMAL(Algorithm_Data *data)
  *
- * OPTIMAL Page Replacement Algorithm
+ * OPTIMAL Page Replacement Algorithm. With the refs in memory the victim is
+ * found by looking ahead from ref_cursor. Out of core the victim is the
+ * resident page whose entry in the trace's per page next-use table,
+ * external.next_seen, is furthest away, so no look-ahead is needed.
+ * Prefetched pages are looked up the same way and get their real next use.
  *
  * @param *data {Algorithm_Data} struct holding algorithm data
  *
@@ -360,17 +3848,29 @@ int OPTIMAL(Algorithm_Data *data)
         while (framep != NULL && framep->page > -1 && framep->page != last_page_ref) {
                 framep = framep->frames.le_next;
         }
-        if(framep == NULL)
+        if(framep == NULL && external.refs != NULL)
+        { // It's a miss, victim is the page used furthest away, looked up in the trace's next-use table
+                for (framep = data->page_table.lh_first; framep != NULL; framep = framep->frames.le_next)
+                        if(victim == NULL || external.next_seen[framep->page] > external.next_seen[victim->page])
+                                victim = framep;
+                if(debug) printf("Victim selected: %d, Page: %d\n", victim->index, victim->page);
+                add_victim(data, victim);
+                victim->page = last_page_ref;
+                victim->time = counter;
+                victim->extra = counter;
+                fault = 1;
+        }
+        else if(framep == NULL)
         { // It's a miss, find our victim
                 size_t i,j;
                 for(i = 0; i < page_ref_upper_bound; ++i)
                         optimum_find_test[i] = -1;
-                Page_Ref *page = page_refs.lh_first;
+                Page_Ref *page = ref_cursor;
                 int all_found = 0;
                 j = 0;
                 //optimum_find_test = malloc(sizeof(int)*page_ref_upper_bound);
-                while(all_found == 0)
-                {
+                while(all_found == 0 && page != NULL)
+                { // pages not seen before the end of the refs are never used again
                         if(optimum_find_test[page->page_num] == -1)
                                 optimum_find_test[page->page_num] = j++;
                         all_found = 1;
@@ -384,29 +3884,30 @@ int OPTIMAL(Algorithm_Data *data)
                 }
                 framep = data->page_table.lh_first;
                 while (framep != NULL) {
-                        if(victim == NULL || optimum_find_test[framep->page] > optimum_find_test[victim->page])
+                        if(victim == NULL || (optimum_find_test[victim->page] != -1 &&
+                           (optimum_find_test[framep->page] == -1 || optimum_find_test[framep->page] > optimum_find_test[victim->page])))
                         { // No victim yet or page used further in future than victim
                                 victim = framep;
                         }
                         framep = framep->frames.le_next;
                 }
                 if(debug) printf("Victim selected: %d, Page: %d\n", victim->index, victim->page);
-                add_victim(&data->victim_list, victim);
+                add_victim(data, victim);
                 victim->page = last_page_ref;
-                time(&victim->time);
+                victim->time = counter;
                 victim->extra = counter;
                 fault = 1;
         }
         else if(framep->page == -1)
         { // Use free page table index
                 framep->page = last_page_ref;
-                time(&framep->time);
+                framep->time = counter;
                 framep->extra = counter;
                 fault = 1;
         }
         else if(framep->page == last_page_ref)
         { // The page was found! Hit!
-                time(&framep->time);
+                framep->time = counter;
                 framep->extra = counter;
         }
         if(debug)
@@ -415,7 +3916,6 @@ int OPTIMAL(Algorithm_Data *data)
                 for (framep = data->page_table.lh_first; framep != NULL; framep = framep->frames.le_next)
                         printf("Slot: %d, Page: %d, Time used: %d\n", framep->index, framep->page, framep->extra);
         }
-        if(fault == 1) data->misses++; else data->hits++;
         return fault;
 }
 
@@ -432,7 +3932,7 @@ int RANDOM(Algorithm_Data *data)
 {
         struct Frame *framep = data->page_table.lh_first,
                      *victim = NULL;
-        int rand_victim = rand() % num_frames;
+        int rand_victim = next_rand() % num_frames;
         int fault = 0;
         /* Find target (hit), empty page index (miss), or victim to evict (miss) */
         while (framep != NULL && framep->page > -1 && framep->page != last_page_ref) {
@@ -443,22 +3943,22 @@ int RANDOM(Algorithm_Data *data)
         if(framep == NULL)
         { // It's a miss, kill our victim
                 if(debug) printf("Victim selected: %d, Page: %d\n", victim->index, victim->page);
-                add_victim(&data->victim_list, victim);
+                add_victim(data, victim);
                 victim->page = last_page_ref;
-                time(&victim->time);
+                victim->time = counter;
                 victim->extra = counter;
                 fault = 1;
         }
         else if(framep->page == -1)
         { // Use free page table index
                 framep->page = last_page_ref;
-                time(&framep->time);
+                framep->time = counter;
                 framep->extra = counter;
                 fault = 1;
         }
         else if(framep->page == last_page_ref)
         { // The page was found! Hit!
-                time(&framep->time);
+                framep->time = counter;
                 framep->extra = counter;
         }
         if(debug)
@@ -467,7 +3967,6 @@ int RANDOM(Algorithm_Data *data)
                 for (framep = data->page_table.lh_first; framep != NULL; framep = framep->frames.le_next)
                         printf("Slot: %d, Page: %d, Time used: %d\n", framep->index, framep->page, framep->extra);
         }
-        if(fault == 1) data->misses++; else data->hits++;
         return fault;
 }
 
@@ -487,8 +3986,8 @@ int FIFO(Algorithm_Data *data)
         int fault = 0;
         /* Find target (hit), empty page index (miss), or victim to evict (miss) */
         while (framep != NULL && framep->page > -1 && framep->page != last_page_ref) {
-                if(victim == NULL || framep->time > victim->time)
-                { // No victim yet or frame older than victim
+                if(victim == NULL || framep->time < victim->time)
+                { // No victim yet or frame loaded before victim
                         victim = framep;
                 }
                 framep = framep->frames.le_next;
@@ -497,25 +3996,23 @@ int FIFO(Algorithm_Data *data)
         if(framep == NULL)
         { // It's a miss, kill our victim
                 if(debug) printf("Victim selected: %d, Page: %d\n", victim->index, victim->page);
-                add_victim(&data->victim_list, victim);
+                add_victim(data, victim);
                 victim->page = last_page_ref;
-                time(&victim->time);
+                victim->time = counter;
                 victim->extra = counter;
                 fault = 1;
         }
         else if(framep->page == -1)
         { // Can use free page table index
                 framep->page = last_page_ref;
-                time(&framep->time);
+                framep->time = counter;
                 framep->extra = counter;
                 fault = 1;
         }
         else if(framep->page == last_page_ref)
-        { // The page was found! Hit!
-                time(&framep->time);
+        { // The page was found! Hit! Load order is unchanged
                 framep->extra = counter;
         }
-        if(fault == 1) data->misses++; else data->hits++;
         return fault;
 }
 
@@ -544,25 +4041,24 @@ int LRU(Algorithm_Data *data)
         if(framep == NULL)
         { // It's a miss, kill our victim
                 if(debug) printf("Victim selected: %d, Page: %d\n", victim->index, victim->page);
-                add_victim(&data->victim_list, victim);
+                add_victim(data, victim);
                 victim->page = last_page_ref;
-                time(&victim->time);
+                victim->time = counter;
                 victim->extra = counter;
                 fault = 1;
         }
         else if(framep->page == -1)
         { // Can use free page table index
                 framep->page = last_page_ref;
-                time(&framep->time);
+                framep->time = counter;
                 framep->extra = counter;
                 fault = 1;
         }
         else if(framep->page == last_page_ref)
         { // The page was found! Hit!
-                time(&framep->time);
+                framep->time = counter;
                 framep->extra = counter;
         }
-        if(fault == 1) data->misses++; else data->hits++;
         return fault;
 }
 
@@ -577,7 +4073,6 @@ int LRU(Algorithm_Data *data)
  */
 int CLOCK(Algorithm_Data *data)
 {
-        static Frame *clock_hand = NULL; // Clock needs a hand
         Frame *framep = data->page_table.lh_first;
         int fault = 0;
         /* Forward traversal. */
@@ -600,24 +4095,23 @@ int CLOCK(Algorithm_Data *data)
         }
         else // Use the hand to find our victim
         {
-                while(clock_hand == NULL || clock_hand->extra == 0)
+                while(data->hand == NULL || data->hand->extra == 0)
                 {
-                        if(clock_hand == NULL)
+                        if(data->hand == NULL)
                         {
-                                clock_hand = data->page_table.lh_first;
+                                data->hand = data->page_table.lh_first;
                         }
                         else
                         {
-                                clock_hand->extra = 1;
-                                clock_hand = clock_hand->frames.le_next;
+                                data->hand->extra = 1;
+                                data->hand = data->hand->frames.le_next;
                         }
                 }
-                add_victim(&data->victim_list, clock_hand);
-                clock_hand->page = last_page_ref;
-                clock_hand->extra = 0;
+                add_victim(data, data->hand);
+                data->hand->page = last_page_ref;
+                data->hand->extra = 0;
                 fault = 1;
         }
-        if(fault == 1) data->misses++; else data->hits++;
         return fault;
 }
 
@@ -644,25 +4138,24 @@ int NFU(Algorithm_Data *data)
         /* Make a decision */
         if(framep == NULL)
         { // It's a miss, kill our victim
-                add_victim(&data->victim_list, victim);
+                add_victim(data, victim);
                 victim->page = last_page_ref;
-                time(&victim->time);
+                victim->time = counter;
                 victim->extra = 0;
                 fault = 1;
         }
         else if(framep->page == -1)
         { // Can use free page table index
                 framep->page = last_page_ref;
-                time(&framep->time);
+                framep->time = counter;
                 framep->extra = 0;
                 fault = 1;
         }
         else if(framep->page == last_page_ref)
         { // The page was found! Hit!
-                time(&framep->time);
+                framep->time = counter;
                 framep->extra++;
         }
-        if(fault == 1) data->misses++; else data->hits++;
         return fault;
 }
 
@@ -690,32 +4183,278 @@ int AGING(Algorithm_Data *data)
         /* Make a decision */
         if(framep == NULL)
         { // It's a miss, kill our victim
-                add_victim(&data->victim_list, victim);
+                add_victim(data, victim);
                 victim->page = last_page_ref;
-                time(&victim->time);
+                victim->time = counter;
                 victim->extra = 0;
                 fault = 1;
         }
         else if(framep->page == -1)
         { // Can use free page table index
                 framep->page = last_page_ref;
-                time(&framep->time);
+                framep->time = counter;
                 framep->extra = 0;
                 fault = 1;
         }
         else if(framep->page == last_page_ref)
         { // The page was found! Hit!
-                time(&framep->time);
+                framep->time = counter;
                 framep->extra = framep->extra+10000000;
                 while (framep->frames.le_next != NULL) {
                         framep = framep->frames.le_next;
                         framep->extra /= 2;
                 }
         }
-        if(fault == 1) data->misses++; else data->hits++;
         return fault;
 }
 
+/**
+ * int WS(Algorithm_Data *data)
+ *
+ * Working Set Page Replacement Algorithm. A process' pages not referenced
+ * in its last ws_window refs of virtual time are released, so resident sets
+ * grow and shrink with their working sets. When memory runs out the page
+ * oldest in its owner's virtual time is evicted.
+ *
+ * @param *data {Algorithm_Data} struct holding algorithm data
+ *
+ * return {int} did page fault, 0 or 1
+ */
+int WS(Algorithm_Data *data)
+{
+        Frame *framep, *target = NULL, *empty = NULL, *victim = NULL;
+        int now = vtime[last_pid], fault = 0;
+        /* Find target (hit), release pages out of the working set, track empty and victim */
+        for (framep = data->page_table.lh_first; framep != NULL; framep = framep->frames.le_next)
+        {
+                if(framep->page == last_page_ref)
+                        target = framep;
+                else if(!prefetching && framep->page > -1 && framep->pid == last_pid && now - framep->time > ws_window)
+                { // Left the working set
+                        add_victim(data, framep);
+                        framep->page = -1;
+                }
+                if(framep->page == -1)
+                {
+                        if(empty == NULL)
+                                empty = framep;
+                }
+                else if(framep != target && (victim == NULL || vtime[framep->pid] - framep->time > vtime[victim->pid] - victim->time))
+                        victim = framep; // No victim or page unused longer in its owner's time
+        }
+        /* Make a decision */
+        if(target == NULL)
+        {
+                if(empty == NULL)
+                { // Out of memory, kill our victim
+                        add_victim(data, victim);
+                        empty = victim;
+                }
+                target = empty;
+                target->page = last_page_ref;
+                fault = 1;
+        }
+        target->pid = last_pid;
+        target->time = now;
+        target->extra = counter;
+        return fault;
+}
+
+/**
+ * int WSCLOCK(Algorithm_Data *data)
+ *
+ * WSCLOCK Page Replacement Algorithm. Refs only set a frame's R bit (extra),
+ * the hand records last use in the owner's virtual time when it clears R.
+ * On a fault the hand evicts the first unreferenced page older than
+ * ws_window, falling back to the oldest page after two sweeps.
+ *
+ * @param *data {Algorithm_Data} struct holding algorithm data
+ *
+ * return {int} did page fault, 0 or 1
+ */
+int WSCLOCK(Algorithm_Data *data)
+{
+        Frame *framep = data->page_table.lh_first,
+              *empty = NULL, *victim = NULL;
+        int i;
+        /* Find target (hit) or empty page slot (miss) */
+        while (framep != NULL && framep->page != last_page_ref)
+        {
+                if(framep->page == -1 && empty == NULL)
+                        empty = framep;
+                framep = framep->frames.le_next;
+        }
+        if(framep != NULL)
+        { // Found the page, set its R bit
+                framep->extra = 1;
+                framep->pid = last_pid;
+                return 0;
+        }
+        if(empty == NULL)
+        { // Use the hand to find our victim
+                for (i = 0; i < 2*num_frames; ++i)
+                {
+                        if(data->hand == NULL)
+                                data->hand = data->page_table.lh_first;
+                        if(data->hand->extra == 1)
+                        { // Referenced, still in working set
+                                data->hand->extra = 0;
+                                data->hand->time = vtime[data->hand->pid];
+                        }
+                        else if(vtime[data->hand->pid] - data->hand->time > ws_window)
+                        { // Out of its owner's working set
+                                victim = data->hand;
+                        }
+                        else if(framep == NULL || vtime[data->hand->pid] - data->hand->time > vtime[framep->pid] - framep->time)
+                        {
+                                framep = data->hand; // Oldest fallback so far
+                        }
+                        data->hand = data->hand->frames.le_next;
+                        if(victim != NULL)
+                                break;
+                }
+                if(victim == NULL)
+                        victim = framep != NULL ? framep : data->page_table.lh_first;
+                add_victim(data, victim);
+                empty = victim;
+        }
+        empty->page = last_page_ref;
+        empty->pid = last_pid;
+        empty->time = vtime[last_pid];
+        empty->extra = 0;
+        return 1;
+}
+
+/**
+ * int PFF(Algorithm_Data *data)
+ *
+ * Page Fault Frequency Page Replacement Algorithm. Each fault resets the
+ * faulting process' R bits (extra); if it came more than pff_threshold refs
+ * of virtual time after the process' last fault, its pages unreferenced
+ * since then are released first. Last fault times are kept in proc_extra.
+ *
+ * @param *data {Algorithm_Data} struct holding algorithm data
+ *
+ * return {int} did page fault, 0 or 1
+ */
+int PFF(Algorithm_Data *data)
+{
+        Frame *framep = data->page_table.lh_first,
+              *empty = NULL, *victim = NULL;
+        int now = vtime[last_pid],
+            shrink = !prefetching && now - data->proc_extra[last_pid] > pff_threshold;
+        /* Find target (hit) */
+        while (framep != NULL && framep->page != last_page_ref)
+                framep = framep->frames.le_next;
+        if(framep != NULL)
+        { // The page was found! Hit!
+                framep->pid = last_pid;
+                framep->time = now;
+                framep->extra = 1;
+                return 0;
+        }
+        /* Fault, shrink or grow the resident set and find empty or victim */
+        for (framep = data->page_table.lh_first; framep != NULL; framep = framep->frames.le_next)
+        {
+                if(!prefetching && framep->page > -1 && framep->pid == last_pid)
+                {
+                        if(shrink && framep->extra == 0)
+                        { // Unused since last fault and faulting slowly
+                                add_victim(data, framep);
+                                framep->page = -1;
+                        }
+                        framep->extra = 0;
+                }
+                if(framep->page == -1)
+                {
+                        if(empty == NULL)
+                                empty = framep;
+                }
+                else if(victim == NULL || vtime[framep->pid] - framep->time > vtime[victim->pid] - victim->time)
+                        victim = framep; // No victim or page unused longer in its owner's time
+        }
+        if(!prefetching)
+                data->proc_extra[last_pid] = now;
+        if(empty == NULL)
+        { // Out of memory, kill our victim
+                add_victim(data, victim);
+                empty = victim;
+        }
+        empty->page = last_page_ref;
+        empty->pid = last_pid;
+        empty->time = now;
+        empty->extra = !prefetching; // Prefetched pages aren't referenced yet
+        return 1;
+}
+
+/**
+ * int LECAR(Algorithm_Data *data)
+ *
+ * LECAR Page Replacement Algorithm. Victims are picked by following an LRU
+ * or LFU expert at random by weight. Each expert's victims go in its ghost
+ * list, and a fault on a ghost page shifts weight to the other expert by a
+ * regret that decays with time since the eviction. Every step is O(1).
+ *
+ * @param *data {Algorithm_Data} struct holding algorithm data
+ *
+ * return {int} did page fault, 0 or 1
+ */
+int LECAR(Algorithm_Data *data)
+{
+        Lecar *lecar;
+        Lecar_Entry *entry;
+        Frame *framep;
+        int expert;
+        double sum;
+        if(data->lecar == NULL)
+                data->lecar = create_lecar(data);
+        lecar = data->lecar;
+        entry = lecar->pages[last_page_ref];
+        if(entry != NULL)
+        { // The page was found! Hit!
+                TAILQ_REMOVE(&lecar->lru, entry, recency);
+                TAILQ_INSERT_HEAD(&lecar->lru, entry, recency);
+                lecar_set_bucket(lecar, entry, entry->bucket->freq + 1);
+                entry->frame->time = counter;
+                entry->frame->extra = entry->bucket->freq;
+                return 0;
+        }
+        if(lecar->ghost[last_page_ref] != 0 && prefetching)
+                lecar->ghost[last_page_ref] = 0; // Back without a demand ref, no regret
+        else if(lecar->ghost[last_page_ref] != 0)
+        { // Expert shouldn't have evicted page, shift weight to the other one
+                expert = lecar->ghost[last_page_ref] - 1;
+                lecar->weight[1 - expert] *= exp(lecar_rate * pow(lecar->discount, counter - lecar->ghost_time[last_page_ref]));
+                sum = lecar->weight[EXPERT_LRU] + lecar->weight[EXPERT_LFU];
+                lecar->weight[EXPERT_LRU] /= sum;
+                lecar->weight[EXPERT_LFU] /= sum;
+                lecar->ghost[last_page_ref] = 0;
+        }
+        if(lecar->num_free == 0)
+        { // It's a miss, follow an expert to our victim
+                expert = (double)next_rand() / (double)RAND_MAX < lecar->weight[EXPERT_LRU] ? EXPERT_LRU : EXPERT_LFU;
+                if(expert == EXPERT_LRU)
+                        entry = TAILQ_LAST(&lecar->lru, Lecar_List);
+                else
+                        entry = TAILQ_LAST(&TAILQ_FIRST(&lecar->lfu)->entries, Lecar_List);
+                framep = entry->frame;
+                if(debug) printf("Victim selected: %d, Page: %d, Expert: %s\n", framep->index, framep->page, expert == EXPERT_LRU ? "LRU" : "LFU");
+                lecar_remember(lecar, expert, framep->page);
+                add_victim(data, framep); // puts frame on the free stack
+        }
+        framep = lecar->free[--lecar->num_free];
+        entry = malloc(sizeof(Lecar_Entry));
+        entry->frame = framep;
+        entry->bucket = NULL;
+        TAILQ_INSERT_HEAD(&lecar->lru, entry, recency);
+        lecar_set_bucket(lecar, entry, 1);
+        lecar->pages[last_page_ref] = entry;
+        framep->page = last_page_ref;
+        framep->time = counter;
+        framep->extra = 1;
+        return 1;
+}
+
 /**
  * int print_help()
  *
@@ -726,10 +4465,52 @@ int AGING(Algorithm_Data *data)
 int print_help(const char *binary)
 {
         printf( "usage: %s algorithm num_frames show_process debug\n", binary);
-        printf( "   algorithm    - page algorithm to use {LRU, CLOCK}\n");
+        printf( "       %s analyze --trace=FILE\n", binary);
+        printf( "   algorithm    - page algorithm to use {ALL, OPTIMAL, RANDOM, FIFO, LRU, CLOCK, NFU, AGING,\n");
+        printf( "                  WS, WSCLOCK, PFF, LECAR}\n");
         printf( "   num_frames   - number of page frames {int > 0}\n");
         printf( "   show_process - print page table after each ref is processed {1 or 0}\n");
         printf( "   debug        - verbose debugging output {1 or 0}\n");
+        printf( "options:\n");
+        printf( "   --prefetch=MODE          - prefetch stage {none, seq, stride, cluster}, default none\n");
+        printf( "   --prefetch-window=N      - pages prefetched per trigger or cluster size, default 4\n");
+        printf( "   --prefetch-priority=PRI  - insert prefetched pages as next victims or as referenced {low, high}\n");
+        printf( "   --tlb                    - simulate a TLB in front of each page table\n");
+        printf( "   --tlb-l1=E:W             - 4K first level TLB entries and ways, default 64:4\n");
+        printf( "   --tlb-l1-2m=E:W          - 2M first level TLB entries and ways, default 32:4\n");
+        printf( "   --tlb-l1-1g=E:W          - 1G first level TLB entries and ways, default 4:4\n");
+        printf( "   --tlb-l2=E:W             - unified second level TLB entries and ways, default 1536:12\n");
+        printf( "   --hugepages=MODE         - huge page mapping {none, thp, 2m, 1g}, default none\n");
+        printf( "   --thp-threshold=N        - resident pages in a 2M region before THP promotes it, default 256\n");
+        printf( "   --pages=N                - number of distinct pages referenced, default 12\n");
+        printf( "   --refs=N                 - number of page refs to simulate, default 1000\n");
+        printf( "   --trace=FILE             - read page refs from FILE, one page [compression ratio [pid]] per line\n");
+        printf( "   --ws-window=N            - working set window in refs of process virtual time, default 100\n");
+        printf( "   --pff-threshold=N        - refs between faults above which PFF shrinks a resident set, default 20\n");
+        printf( "   --lecar-rate=R           - LECAR learning rate for expert weights, default 0.45\n");
+        printf( "   --sample=N               - simulate representative intervals of N refs instead of every ref\n");
+        printf( "   --sample-clusters=K      - number of interval clusters, default 8\n");
+        printf( "   --sample-warmup=N        - refs replayed before each representative to warm up, default N\n");
+        printf( "   --sample-check           - also run every ref and report sampling error\n");
+        printf( "   --sets=N                 - split frames into N sets picked by page hash, each with its own page table\n");
+        printf( "   --tenants=S[:H],...      - partition per process with S frames guaranteed and up to H by borrowing\n");
+        printf( "   --partition-jobs=N       - worker processes simulating sets in parallel, default one per CPU\n");
+        printf( "   --external[=N]           - stream the trace from disk N refs at a time, OPTIMAL without the trace in memory\n");
+        printf( "   --metrics=FILE           - write hits, faults, evictions and resident pages per window to FILE, - for stdout\n");
+        printf( "   --metrics-window=N       - refs per metrics window, default 1000\n");
+        printf( "   --metrics-format=FMT     - metrics as text rows or binary column blocks {csv, bin}, default csv\n");
+        printf( "   --checkpoint=FILE        - write simulation state to FILE in the background every --checkpoint-every refs\n");
+        printf( "   --checkpoint-every=N     - refs between checkpoints, default 10000\n");
+        printf( "   --resume=FILE            - continue from a checkpoint instead of the first ref\n");
+        printf( "   --fork=N[,N...]          - with --resume, continue once per frame count from the same checkpoint\n");
+        printf( "   --analyze-epoch=N        - refs per working set size epoch in analyze mode, default 10000\n");
+        printf( "   --analyze-rate=R         - fraction of pages analyze tracks reuse for, default 1\n");
+        printf( "   --analyze-topk=K         - hot pages analyze monitors, default 32\n");
+        printf( "   --zswap=BYTES            - compress victims into a pool of BYTES before swap\n");
+        printf( "   --zswap-writeback=MODE   - when pool is full {lru: write back oldest, none: reject new}\n");
+        printf( "   --zswap-ratio=MIN:MAX    - compression ratios drawn for pages the trace doesn't give, default 1.5:4\n");
+        printf( "   --zswap-costs=C:D        - compress and decompress us per page, default 10:3\n");
+        printf( "   --swap-costs=R:W         - swap read and write us per page, default 100:50\n");
         return 0;
 }
 
@@ -757,6 +4538,49 @@ int print_summary(Algorithm algo)
         printf("Hits: %d, ", algo.data->hits);
         printf("Misses: %d, ", algo.data->misses);
         printf("Hit Ratio: %f\n", (double)algo.data->hits/(double)(algo.data->hits+algo.data->misses));
+        printf("Mean Resident: %f, ", (double)algo.data->space_time/(double)(algo.data->hits+algo.data->misses));
+        printf("Memory-Time: %ld\n", algo.data->space_time);
+        if(prefetch_mode != PREFETCH_NONE)
+        {
+                printf("Prefetches: %d, ", algo.data->prefetches);
+                printf("Useful: %d, ", algo.data->prefetch_hits);
+                printf("Wasted: %d, ", algo.data->prefetch_wasted);
+                printf("Unused: %d, ", algo.data->prefetch_unused);
+                printf("Accuracy: %f, ", algo.data->prefetches == 0 ? 0.0 :
+                       (double)algo.data->prefetch_hits/(double)algo.data->prefetches);
+                printf("Coverage: %f\n", algo.data->prefetch_hits + algo.data->misses == 0 ? 0.0 :
+                       (double)algo.data->prefetch_hits/(double)(algo.data->prefetch_hits+algo.data->misses));
+        }
+        if(algo.data->tlb != NULL)
+        {
+                Tlb *tlb = algo.data->tlb;
+                printf("TLB L1 Misses: %d, ", tlb->l1[PAGE_4K].misses + tlb->l1[PAGE_2M].misses + tlb->l1[PAGE_1G].misses);
+                printf("L2 Misses: %d, ", tlb->l2.misses);
+                printf("TLB Miss Ratio: %f, ", (double)tlb->walks/(double)(algo.data->hits+algo.data->misses));
+                printf("Fault Ratio: %f", (double)algo.data->misses/(double)(algo.data->hits+algo.data->misses));
+                if(hugepages == HUGEPAGES_THP)
+                        printf(", Promotions: %d, Demotions: %d", tlb->promotions, tlb->demotions);
+                printf("\n");
+        }
+        if(algo.data->zswap != NULL)
+        {
+                Zswap *zswap = algo.data->zswap;
+                printf("Zswap Stores: %d, ", zswap->stores);
+                printf("Rejects: %d, ", zswap->rejects);
+                printf("Loads: %d, ", zswap->loads);
+                printf("Writebacks: %d, ", zswap->writebacks);
+                printf("Swap Ins: %d, ", zswap->swapins);
+                printf("Pool Bytes: %ld\n", zswap->used);
+                printf("CPU us: %.0f, ", zswap->cpu_us);
+                printf("I/O us: %.0f, ", zswap->io_us);
+                printf("Total us: %.0f\n", zswap->cpu_us + zswap->io_us);
+        }
+        if(algo.data->lecar != NULL)
+        {
+                printf("Expert Weights: LRU %f, ", algo.data->lecar->weight[EXPERT_LRU]);
+                printf("LFU %f\n", algo.data->lecar->weight[EXPERT_LFU]);
+                lecar_check(algo.data);
+        }
         return 0;
 }
 
@@ -818,17 +4642,36 @@ int print_list(struct Frame *head, const char* index_label, const char* value_la
 int cleanup()
 {
         size_t i = 0;
+        int p;
         for (i = 0; i < num_algos; i++)
         {
-                /* Clean up memory, delete the list */
-                while (algos[i].data->page_table.lh_first != NULL)
-                {
-                        LIST_REMOVE(algos[i].data->page_table.lh_first, frames);
-                }
-                while (algos[i].data->victim_list.lh_first != NULL)
-                {
-                        LIST_REMOVE(algos[i].data->victim_list.lh_first, frames);
-                }
+                free_algo_data_store(algos[i].data);
+        }
+        free(vtime);
+        free(page_ratios);
+        free(prefetcher.candidates);
+        free(fork_frames);
+        free(tenant_soft);
+        free(tenant_hard);
+        for (p = 0; partitions != NULL && p < num_partitions; ++p)
+        {
+                for (i = 0; i < num_algos; i++)
+                        free_algo_data_store(partitions[p].data[i]);
+                free(partitions[p].data);
+                free(partitions[p].frames);
+                free(partitions[p].borrowed);
+                free(partitions[p].reclaimed);
+        }
+        free(partitions);
+        if(external.refs != NULL)
+        { // temporary files are deleted on close
+                fclose(external.refs);
+                fclose(external.uses);
+                free(external.ref_buf);
+                free(external.use_buf);
+                free(external.next_seen);
         }
+        if(metrics.out != NULL)
+                metrics_close();
         return 0;
 }
@@ -14,6 +14,8 @@ typedef struct Page_Ref
 {
         LIST_ENTRY(Page_Ref) pages; // frames node, next
         int page_num;
+        float ratio; // compression ratio of page at this ref, 0 if unknown
+        int pid; // process making the ref
 } Page_Ref;
 
 // stuct to hold Frame info
@@ -22,10 +24,110 @@ typedef struct Frame
         LIST_ENTRY(Frame) frames; // frames node, next
         int index; // frame position in list... not really needed
         int page; // page frame points to, -1 is empty
-        time_t time; // time added/accessed
+        time_t time; // ref # added/accessed, process virtual time for WS, WSCLOCK and PFF
         int extra; // extra field for per-algo use
+        int prefetched; // ref # page was prefetched at, -1 if demand paged or already used
+        int pid; // process that last referenced page
 } Frame;
 
+// Translation sizes, 4K pages are the unit of page refs
+typedef enum {
+        PAGE_4K, // base page
+        PAGE_2M, // huge page covering 512 base pages
+        PAGE_1G // huge page covering 512 2M pages
+} Page_Size;
+
+// stuct to hold one set associative TLB level
+typedef struct {
+        int entries; // total entries
+        int ways; // entries per set
+        int sets; // entries / ways
+        long *tags; // (vpn << 2 | Page_Size) per entry, -1 is empty
+        int *used; // tick entry was last used, for LRU within a set
+        int hits; // lookups found in this level
+        int misses; // lookups not found in this level
+} Tlb_Level;
+
+// stuct to hold a TLB in front of an algorithm's page table
+typedef struct {
+        Tlb_Level l1[3]; // first level split by Page_Size
+        Tlb_Level l2; // unified second level
+        int tick; // lookups so far, orders entries for LRU
+        int walks; // page table walks, misses in every level
+        int *region_pages; // resident base pages per 2M region
+        char *region_huge; // 1 if 2M region is mapped by a huge page
+        int promotions; // 2M regions collapsed into huge pages
+        int demotions; // huge pages split by eviction of a base page
+} Tlb;
+
+// stuct to hold a page stored in the compressed pool
+typedef struct Zswap_Entry
+{
+        TAILQ_ENTRY(Zswap_Entry) entries; // pool LRU node, head is most recently stored
+        int page; // page stored
+        int size; // compressed bytes
+} Zswap_Entry;
+// List for compressed pool LRU
+TAILQ_HEAD(Zswap_List, Zswap_Entry);
+
+// stuct to hold a compressed memory pool between an algorithm and swap
+typedef struct {
+        struct Zswap_List lru; // stored pages, tail is written back first
+        Zswap_Entry **pages; // entry per page, NULL if page isn't in pool
+        char *swapped; // 1 if page was written to swap and not read back
+        long used; // compressed bytes in pool
+        int stores; // pages compressed into pool
+        int rejects; // evicted pages sent straight to swap
+        int loads; // faults served by decompressing from pool
+        int writebacks; // pool pages written to swap to make room
+        int swapins; // faults served by reading swap
+        double cpu_us; // compress and decompress time
+        double io_us; // swap read and write time
+} Zswap;
+
+// LECAR experts
+typedef enum {
+        EXPERT_LRU, // evict least recently used page
+        EXPERT_LFU // evict least frequently used page, least recently used among ties
+} Lecar_Expert;
+
+// stuct to hold a resident page's place in LECAR's recency and frequency orders
+typedef struct Lecar_Entry
+{
+        TAILQ_ENTRY(Lecar_Entry) recency; // LRU list node, head is most recently used
+        TAILQ_ENTRY(Lecar_Entry) frequency; // bucket list node, head is most recently used
+        struct Lecar_Bucket *bucket; // bucket holding pages with this page's frequency
+        Frame *frame; // frame holding page
+} Lecar_Entry;
+// List for LECAR recency and frequency orders
+TAILQ_HEAD(Lecar_List, Lecar_Entry);
+
+// stuct to hold pages referenced the same number of times
+typedef struct Lecar_Bucket
+{
+        TAILQ_ENTRY(Lecar_Bucket) buckets; // bucket list node, ascending freq
+        int freq; // refs to each page in bucket
+        struct Lecar_List entries; // pages in bucket
+} Lecar_Bucket;
+// List for LECAR frequency buckets
+TAILQ_HEAD(Lecar_Bucket_List, Lecar_Bucket);
+
+// stuct to hold LECAR state, shared LRU/LFU metadata plus expert ghost lists
+typedef struct {
+        Lecar_Entry **pages; // entry per page, NULL if page isn't resident
+        struct Lecar_List lru; // resident pages by recency
+        struct Lecar_Bucket_List lfu; // frequency buckets, head is least frequent
+        Frame **free; // stack of empty frames
+        int num_free; // frames on free stack
+        char *ghost; // per page, expert that evicted it + 1, 0 if not in a ghost list
+        int *ghost_slot; // per page, slot in its expert's history ring
+        int *ghost_time; // per page, ref # it was evicted at
+        int *history[2]; // ring of evicted pages per expert, num_frames long
+        int history_pos[2]; // next slot to overwrite per expert
+        double weight[2]; // probability of following each expert
+        double discount; // regret decay per ref since eviction
+} Lecar;
+
 // stuct to hold Algorithm data
 typedef struct {
         int hits; // number of times page was found in page table
@@ -33,8 +135,46 @@ typedef struct {
         struct Frame_List page_table; // List to hold frames in page table
         struct Frame_List victim_list; // List to hold frames that were replaced in page table
         Frame *last_victim; // Holds last frame used as a victim to make inserting to victim list faster
+        Frame *hand; // Clock hand for CLOCK style algorithms, NULL before first sweep
+        int *proc_extra; // extra field per process for per-algo use
+        int resident; // number of frames holding a page
+        long space_time; // sum of resident frames over every ref, the memory-time integral
+        int prefetches; // number of pages brought in by the prefetcher
+        int prefetch_hits; // number of prefetched pages referenced before eviction
+        int prefetch_wasted; // number of prefetched pages evicted without being referenced
+        int prefetch_unused; // number of prefetched pages resident and unreferenced when the run ended
+        int evictions; // number of pages evicted from page_table
+        Tlb *tlb; // TLB in front of page_table, NULL if TLB isn't simulated
+        Zswap *zswap; // compressed pool behind victims, NULL if not simulated
+        Lecar *lecar; // LECAR state, NULL for other algorithms
 } Algorithm_Data;
 
+// stuct to hold a sampled page's first and last ref for trace analysis
+typedef struct {
+        int page; // page number, -1 is an empty slot
+        long first; // ref # of first ref, from 1
+        long last; // ref # of latest ref, from 1
+} Page_Stats;
+
+// stuct to hold streaming trace analysis state, fixed size apart from sampled pages
+typedef struct {
+        long refs; // refs seen
+        Page_Stats *pages; // open addressing table of sampled pages
+        long table_size; // slots in pages, a power of 2
+        long num_pages; // sampled pages in table
+        double reuse_count[64]; // reuse times per log2 bin
+        double reuse_sum[64]; // sum of reuse times per log2 bin
+        double first_count[64]; // first ref times per log2 bin
+        double first_sum[64]; // sum of first ref times per log2 bin
+        unsigned char hll[4096]; // HyperLogLog registers for unique pages
+        long cms[4][1024]; // Count-Min sketch of page refs
+        int *top_pages; // Space-Saving monitored pages, -1 is unused
+        long *top_counts; // Space-Saving counts, overestimates by at most top_errors
+        long *top_errors; // Space-Saving count of the page each slot replaced
+        long epoch_start; // ref # current working set epoch started at
+        long epoch_pages; // sampled pages referenced in current epoch
+} Trace_Analysis;
+
 // an Algorithm
 typedef struct {
         const char *label; // Algorithm name
@@ -43,23 +183,227 @@ typedef struct {
         Algorithm_Data *data; // Holds algorithm data to pass into algorithm function
 } Algorithm;
 
+// Prefetcher detection modes
+typedef enum {
+        PREFETCH_NONE, // demand paging only
+        PREFETCH_SEQ, // readahead after sequential refs
+        PREFETCH_STRIDE, // readahead along a repeated stride
+        PREFETCH_CLUSTER // fault-around, bring in the aligned cluster of the faulting page
+} Prefetch_Mode;
+
+// Huge page modes
+typedef enum {
+        HUGEPAGES_NONE, // base pages only
+        HUGEPAGES_THP, // promote hot 2M regions, split them when a page is evicted
+        HUGEPAGES_2M, // every region statically mapped by 2M pages
+        HUGEPAGES_1G // every region statically mapped by 1G pages
+} Hugepages_Mode;
+
+// stuct to hold prefetcher stream detection state
+typedef struct {
+        int last_ref; // previous page ref seen by the prefetcher, -1 if none
+        int stride; // difference between the last two page refs
+        int run; // number of consecutive refs that repeated stride
+        int *candidates; // pages to prefetch for the current page ref
+        int num_candidates; // number of pages in candidates
+} Prefetcher;
+
+// stuct to hold a page ref as spilled to disk for out of core runs
+typedef struct {
+        int page_num; // page referenced
+        float ratio; // compression ratio of page at this ref, 0 if unknown
+        int pid; // process making the ref
+} Trace_Record;
+
+// stuct to hold an out of core trace, streamed a chunk at a time with its next-use positions
+typedef struct {
+        FILE *refs; // Trace_Records in trace order, NULL if trace is in memory
+        FILE *uses; // next-use position per ref, chunks stored last chunk first
+        int64_t num_refs; // refs in trace
+        int chunk; // refs per chunk
+        int64_t num_chunks; // chunks in trace
+        Trace_Record *ref_buf; // refs of loaded chunk
+        int64_t *use_buf; // next-use positions of loaded chunk, INT64_MAX if never used again
+        int64_t loaded; // chunk in buffers, -1 if none
+        int64_t pos; // position of next ref get_ref() returns
+        int64_t *next_seen; // per page, position it's next used at from pos, INT64_MAX if never
+} External_Trace;
+
+// Memory partitioning modes
+typedef enum {
+        PARTITION_NONE, // one fully associative page table
+        PARTITION_SETS, // fixed size sets picked by page hash
+        PARTITION_TENANTS // partition per process with soft and hard quotas
+} Partition_Mode;
+
+// stuct to hold a partition of memory, with its own page table per algorithm
+typedef struct {
+        Algorithm_Data **data; // state per algorithm, parallel to algos
+        int *frames; // frames per algorithm, tenants grow and shrink as they borrow
+        int *borrowed; // frames gained past the starting share per algorithm
+        int *reclaimed; // frames lent out or taken back per algorithm
+        int soft; // frames guaranteed, reclaimed from borrowers on demand
+        int hard; // most frames partition may hold
+        int refs; // refs routed to partition
+        int synced; // refs its memory-time covers, brought up to date only when it's touched
+        unsigned long long rand_state; // next_rand() state of this partition's algorithms
+} Partition;
+
+// Metrics output formats
+typedef enum {
+        METRICS_CSV, // one text row per algorithm per window
+        METRICS_BIN // blocks of rows stored column by column
+} Metrics_Format;
+
+// Columns of a metrics row
+typedef enum {
+        METRIC_REF, // ref # window ended at
+        METRIC_FRAMES, // frames in memory
+        METRIC_ALGO, // position of algorithm in algos
+        METRIC_REFS, // refs in window
+        METRIC_HITS, // hits in window
+        METRIC_MISSES, // faults in window
+        METRIC_EVICTIONS, // evictions in window
+        METRIC_RESIDENT, // resident pages at end of window
+        METRIC_COLUMNS // number of columns
+} Metric_Column;
+
+// stuct to hold windowed metrics stream state
+typedef struct {
+        FILE *out; // metrics stream, NULL if metrics are off
+        int window_start; // ref # current window started at
+        int *last_hits; // hits per algorithm when window started
+        int *last_misses; // misses per algorithm when window started
+        int *last_evictions; // evictions per algorithm when window started
+        int *columns[METRIC_COLUMNS]; // binary rows not yet written, column by column
+        int rows; // binary rows buffered in columns
+        int capacity; // rows columns can hold
+} Metrics;
+
 /**
  * Init/cleanup functions
  */
 int init(); // init lists and variable, set up config defaults, and load configs
 void gen_page_refs();
+int load_page_refs(const char *path); // read page refs from a trace file
+int external_load(const char *path); // spill trace to disk and compute next-use positions backwards
+int external_chunk_load(int64_t chunk); // read a chunk of refs and its next-use positions
+int external_ref(); // next ref of an out of core trace
+int external_seek(int64_t pos); // move an out of core trace to pos, recomputing next uses
 Page_Ref* gen_ref();
 Algorithm_Data *create_algo_data_store(); // returns empty algorithm data
+void free_algo_data_store(Algorithm_Data *data); // frees algorithm data and everything it holds
+int reset_algos(); // replace every algorithm's data and prefetcher state with empty ones
 Frame *create_empty_frame(int index); // returns empty frame
 int cleanup(); // frees allocated memory
+int parse_option(const char *arg); // parse a --name=value option
+int create_partitions(); // split frames into sets or tenant partitions
 
 /**
  * Control functions
  */
 int event_loop(); // loops for each page call
 int page(int page_ref); // page all algos with page ref
+int page_algo(Algorithm *algo, int page_ref); // page one algorithm's page table with page ref
 int get_ref(); // get next page ref however you like
-int add_victim(struct Frame_List *victim_list, struct Frame *frame); // add victim frame to a victim list
+int simulate_refs(int start, int warmup, int len); // page refs start...start+len after warming up on the refs before
+int add_victim(Algorithm_Data *data, struct Frame *frame); // add victim frame to an algorithm's victim list
+int page_in(Algorithm_Data *data, int page_ref); // page faulted into an algorithm's page table
+Frame *find_frame(Algorithm_Data *data, int page_ref); // find frame holding page, NULL if not resident
+
+/**
+ * Partition functions
+ */
+int partition_of(int page_ref, int pid); // partition a ref is routed to
+int partition_page(int page_ref); // page every algorithm's table in the ref's partition
+int partition_borrow(int p, size_t i); // grow a tenant by a frame from the pool or another tenant
+int partition_sync(Partition *part); // add resident frames since last touched to memory-time
+int remove_empty_frame(Algorithm_Data *data); // drop an empty frame from a page table
+int partition_loop(); // simulate sets in parallel worker processes
+int partition_totals(); // sum partition stats into each algorithm's data for the summary
+int print_partitions(); // per partition stats
+
+/**
+ * Metrics functions
+ */
+int metrics_open(); // open metrics stream and buffers
+int metrics_start(); // start a window at the current ref
+int metrics_window(); // emit a row per algorithm for the window ending now
+int metrics_flush(); // write buffered binary rows as one columnar block
+int metrics_close(); // flush and close metrics stream
+
+/**
+ * Prefetch functions
+ */
+int prefetch_detect(int page_ref); // update stream detection and pick pages to prefetch
+int prefetch_check(Algorithm_Data *data, int page_ref); // prefetch accounting before a demand ref
+int prefetch_issue(Algorithm *algo); // insert candidate pages into an algorithm's page table
+int count_prefetch_unused(Algorithm_Data *data); // count resident prefetched pages not yet referenced
+
+/**
+ * TLB functions
+ */
+Tlb *create_tlb(); // returns empty TLB with configured geometry
+int tlb_level_init(Tlb_Level *level, int entries, int ways); // allocate an empty TLB level
+int tlb_level_lookup(Tlb_Level *level, long tag, int tick); // look up tag, fill on miss
+int tlb_level_invalidate(Tlb_Level *level, long tag); // drop tag from level
+int tlb_page_size(Tlb *tlb, int page_ref); // size of translation mapping a page
+int tlb_translate(Tlb *tlb, int page_ref, int fault); // translate a page ref through the TLB levels
+int tlb_map(Tlb *tlb, int page_ref); // page made resident, may promote its region
+int tlb_unmap(Tlb *tlb, int page_ref); // page evicted, shoot down and split huge page
+void free_tlb(Tlb *tlb); // frees TLB memory
+
+/**
+ * Compressed pool functions
+ */
+Zswap *create_zswap(); // returns empty compressed pool
+float page_ratio(int page_ref); // compression ratio of a page
+int zswap_store(Zswap *zswap, int page_ref); // compress evicted page, spill to swap if needed
+int zswap_load(Zswap *zswap, int page_ref); // bring faulting page back from pool or swap
+void free_zswap(Zswap *zswap); // frees pool memory
+
+/**
+ * LECAR functions
+ */
+Lecar *create_lecar(Algorithm_Data *data); // returns LECAR state with every frame free
+int lecar_set_bucket(Lecar *lecar, Lecar_Entry *entry, int freq); // move page to head of its freq bucket
+int lecar_remember(Lecar *lecar, int expert, int page_ref); // add page to expert's ghost list
+int lecar_forget(Lecar *lecar, Frame *frame); // drop evicted page from recency and frequency orders
+int lecar_check(Algorithm_Data *data); // print LECAR's state size or its first inconsistency
+void free_lecar(Lecar *lecar); // frees LECAR memory
+
+/**
+ * Sampling functions
+ */
+int sample_loop(); // simulate representative intervals and estimate hit ratios
+int interval_signature(Page_Ref *start, int len, double *sig); // random projection of an interval's page frequencies
+int cluster_intervals(double *sigs, int num_intervals, int k, int *cluster); // k-means on interval signatures
+
+/**
+ * Checkpoint functions
+ */
+int checkpoint(); // snapshot simulation state and write it in the background
+int checkpoint_reap(int wait); // collect finished background checkpoint writer
+int write_checkpoint(const char *path); // write every algorithm's state and the trace position
+int read_checkpoint(const char *path, int frames); // restore state, optionally resized to frames
+int save_frame(FILE *f, Frame *frame); // write one frame's fields
+int load_frame(FILE *f, Frame *frame); // read one frame's fields
+int save_algo_data(FILE *f, Algorithm_Data *data); // write an algorithm's state
+int load_algo_data(FILE *f, Algorithm_Data *data); // fill an empty algorithm data from a checkpoint
+int resize_frames(Algorithm_Data *data, int frames); // add empty frames or evict and drop the highest ones
+int lecar_resize(Lecar *lecar, int frames); // resize LECAR free stack and ghost lists
+int resume_loop(); // run the rest of the refs from a checkpoint, once per what-if frame count
+
+/**
+ * Trace analysis functions
+ */
+int analyze_trace(); // stream refs once and print workload characterization
+int analyze_ref(Trace_Analysis *analysis, int page_ref); // add one ref to analysis
+Page_Stats *analysis_page(Trace_Analysis *analysis, int page_ref); // find or add sampled page
+int print_analysis(Trace_Analysis *analysis); // print reuse, footprint and skew profiles
+unsigned long long hash64(unsigned long long x); // mix bits of a key for sketches
+unsigned long long hash_ref(unsigned long long hash, int page_ref, float ratio, int pid); // fold a ref into a trace checksum
+int next_rand(); // draw from the simulation's random number generator
 
 /**
  * Output functions
@@ -79,5 +423,9 @@ int LRU(Algorithm_Data *data);
 int CLOCK(Algorithm_Data *data);
 int NFU(Algorithm_Data *data);
 int AGING(Algorithm_Data *data);
+int WS(Algorithm_Data *data);
+int WSCLOCK(Algorithm_Data *data);
+int PFF(Algorithm_Data *data);
+int LECAR(Algorithm_Data *data);
 
 #endif
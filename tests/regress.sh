@@ -0,0 +1,440 @@
+#!/bin/sh
+# Trace-driven regression checks, run by make test from the top directory.
+# Each check runs pagesim on a trace in tests/ and compares its output with
+# an invariant or with another run that must agree.
+#
+# usage: sh tests/regress.sh [pagesim binary]
+
+PAGESIM=${1:-./pagesim}
+TESTS=$(dirname "$0")
+TMP=$(mktemp -d)
+trap 'rm -rf "$TMP"' EXIT
+failed=0
+
+# pass NAME / fail NAME REASON
+pass()
+{
+        echo "PASS $1"
+}
+fail()
+{
+        echo "FAIL $1: $2"
+        failed=1
+}
+
+# Every fault must walk the page table, so a TLB's L2 misses (walks) can
+# never be fewer than the page table's misses, with any huge page mode.
+check_tlb_walks()
+{
+        for mode in none thp 2m 1g; do
+                for frames in 16 64 512; do
+                        if ! "$PAGESIM" ALL $frames 0 0 --trace="$TESTS/mixed.trace" --tlb --hugepages=$mode \
+                                --thp-threshold=8 > "$TMP/tlb.out"; then
+                                fail tlb_walks "pagesim failed with --hugepages=$mode, $frames frames"
+                                return
+                        fi
+                        bad=$(awk -F', ' '
+                                /Hit Ratio/ { for (i = 1; i <= NF; ++i) if ($i ~ /^Misses: /) { split($i, f, ": "); misses = f[2] } }
+                                /^TLB L1 Misses/ { split($2, f, ": "); if (f[2] + 0 < misses + 0) print f[2] " walks, " misses " faults" }
+                        ' "$TMP/tlb.out")
+                        if [ -n "$bad" ]; then
+                                fail tlb_walks "--hugepages=$mode, $frames frames: $(echo $bad)"
+                                return
+                        fi
+                done
+        done
+        pass tlb_walks
+}
+
+# HyperLogLog's unique page estimate must be within 3 standard errors
+# (1.04/sqrt(4096) each) of the real count. Every hot page's count must be
+# at least its real count, and over it by no more than Count-Min's bound of
+# e/1024 of the refs. No coverage line may be printed twice.
+check_sketches()
+{
+        for trace in seq mixed; do
+                for topk in 8 10 32; do
+                        if ! "$PAGESIM" analyze --trace="$TESTS/$trace.trace" --analyze-topk=$topk > "$TMP/analyze.out"; then
+                                fail sketches "analyze failed on $trace.trace"
+                                return
+                        fi
+                        bad=$(awk -F', ' '
+                                FNR == NR { if ($1 !~ /^#/ && $1 != "") { split($1, f, " "); if (!(f[1] in count)) unique++; count[f[1]]++; refs++ } next }
+                                /^Refs: .*Unique Pages/ {
+                                        split($2, f, ": ")
+                                        if (f[2] < unique*(1 - 3*1.04/64) || f[2] > unique*(1 + 3*1.04/64))
+                                                print "HLL " f[2] " for " unique " unique pages"
+                                }
+                                /^Page: / {
+                                        split($1, p, ": "); split($2, f, ": ")
+                                        if (f[2] < count[p[2]] || f[2] > count[p[2]] + exp(1)*refs/1024)
+                                                print "page " p[2] " counted " f[2] " for " count[p[2]] + 0 " refs"
+                                }
+                                /^Top [0-9]* Coverage/ { split($0, t, ":"); if (printed[t[1]]++) print "repeated " t[1] }
+                        ' "$TESTS/$trace.trace" "$TMP/analyze.out")
+                        if [ -n "$bad" ]; then
+                                fail sketches "$trace.trace, top $topk: $(echo $bad)"
+                                return
+                        fi
+                done
+        done
+        pass sketches
+}
+
+# Writing checkpoints mustn't change a run, and resuming from the last one,
+# or forking from it with the same frame count, must finish the run exactly
+# as it went without stopping. A truncated checkpoint, or one resumed on a
+# trace with one ref changed, must be refused.
+check_resume()
+{
+        for opts in "--trace=$TESTS/seq.trace --prefetch=seq" \
+                    "--trace=$TESTS/mixed.trace --tlb --prefetch=stride --zswap=65536"; do
+                "$PAGESIM" ALL 64 0 0 $opts > "$TMP/run.out"
+                "$PAGESIM" ALL 64 0 0 $opts --checkpoint="$TMP/ck" --checkpoint-every=1300 > "$TMP/ck.out"
+                if ! cmp -s "$TMP/run.out" "$TMP/ck.out"; then
+                        fail resume "writing checkpoints changed the run with $opts"
+                        return
+                fi
+                "$PAGESIM" ALL 64 0 0 $opts --resume="$TMP/ck" | grep -v '^Resumed ' > "$TMP/resume.out"
+                if ! cmp -s "$TMP/run.out" "$TMP/resume.out"; then
+                        fail resume "resumed run differs with $opts"
+                        return
+                fi
+                "$PAGESIM" ALL 64 0 0 $opts --resume="$TMP/ck" --fork=64,32 | awk '/^What-if/ { n++; next } n == 1' > "$TMP/fork.out"
+                if ! cmp -s "$TMP/run.out" "$TMP/fork.out"; then
+                        fail resume "fork at the same frame count differs with $opts"
+                        return
+                fi
+                head -c 300 "$TMP/ck" > "$TMP/short"
+                if "$PAGESIM" ALL 64 0 0 $opts --resume="$TMP/short" | grep -q 'Algorithm$'; then
+                        fail resume "truncated checkpoint was resumed with $opts"
+                        return
+                fi
+                trace=$(echo "$opts" | sed 's/^--trace=\([^ ]*\).*/\1/')
+                sed '5s/^[0-9]*/7/' "$trace" > "$TMP/other.trace"
+                if "$PAGESIM" ALL 64 0 0 $(echo "$opts" | sed "s|^--trace=[^ ]*|--trace=$TMP/other.trace|") --resume="$TMP/ck" \
+                        | grep -q 'Algorithm$'; then
+                        fail resume "checkpoint was resumed on a different trace with $opts"
+                        return
+                fi
+        done
+        pass resume
+}
+
+# OPTIMAL streaming the trace from disk must pick the same victims as with
+# the trace in memory, whatever the chunk size and prefetch mode, and when
+# resumed from a checkpoint.
+check_external()
+{
+        for trace in seq mixed; do
+                for prefetch in none seq stride cluster; do
+                        opts="--trace=$TESTS/$trace.trace --prefetch=$prefetch"
+                        "$PAGESIM" OPTIMAL 32 0 0 $opts > "$TMP/memory.out"
+                        for chunk in 1 7 1000 100000; do
+                                "$PAGESIM" OPTIMAL 32 0 0 $opts --external=$chunk > "$TMP/external.out"
+                                if ! cmp -s "$TMP/memory.out" "$TMP/external.out"; then
+                                        fail external "$trace.trace, --prefetch=$prefetch, --external=$chunk"
+                                        return
+                                fi
+                        done
+                done
+        done
+        opts="--trace=$TESTS/mixed.trace --prefetch=stride"
+        "$PAGESIM" OPTIMAL 32 0 0 $opts > "$TMP/memory.out"
+        "$PAGESIM" OPTIMAL 32 0 0 $opts --external=7 --checkpoint="$TMP/ck" --checkpoint-every=1300 > /dev/null
+        "$PAGESIM" OPTIMAL 32 0 0 $opts --external=7 --resume="$TMP/ck" | grep -v '^Resumed ' > "$TMP/external.out"
+        if ! cmp -s "$TMP/memory.out" "$TMP/external.out"; then
+                fail external "resumed --external run differs"
+                return
+        fi
+        pass external
+}
+
+# Sets never share frames, so splitting them over more worker processes
+# mustn't change any set's results, random draws included. Tenants run in
+# one process whatever the job count.
+check_partition_jobs()
+{
+        for opts in "--trace=$TESTS/mixed.trace --sets=4" "--trace=$TESTS/seq.trace --sets=3 --prefetch=seq" \
+                    "--trace=$TESTS/mixed.trace --tenants=8:24,8:24,16"; do
+                "$PAGESIM" ALL 48 0 0 $opts --partition-jobs=1 > "$TMP/jobs1.out"
+                for jobs in 2 3 4; do
+                        "$PAGESIM" ALL 48 0 0 $opts --partition-jobs=$jobs > "$TMP/jobs.out"
+                        if ! cmp -s "$TMP/jobs1.out" "$TMP/jobs.out"; then
+                                fail partition_jobs "$opts differs with --partition-jobs=$jobs"
+                                return
+                        fi
+                done
+        done
+        pass partition_jobs
+}
+
+# Textbook fault counts on Belady's string 1 2 3 4 1 2 5 1 2 3 4 5. FIFO
+# faults more with 4 frames than with 3, OPTIMAL and LRU don't.
+check_belady()
+{
+        for expect in "OPTIMAL 3 7" "FIFO 3 9" "LRU 3 10" "OPTIMAL 4 6" "FIFO 4 10" "LRU 4 8"; do
+                set -- $expect
+                misses=$("$PAGESIM" $1 $2 0 0 --trace="$TESTS/belady.trace" | sed -n 's/.*, Misses: \([0-9]*\),.*/\1/p')
+                if [ "$misses" != "$3" ]; then
+                        fail belady "$1 with $2 frames faulted $misses times, expected $3"
+                        return
+                fi
+        done
+        pass belady
+}
+
+# Every prefetched page is eventually referenced, evicted unreferenced or
+# still resident unreferenced, so issued = useful + wasted + unused, with
+# any prefetcher, priority and partitioning.
+check_prefetch()
+{
+        for priority in low high; do
+                for mode in seq stride cluster; do
+                        for opts in "--trace=$TESTS/seq.trace" "--trace=$TESTS/mixed.trace --sets=3 --partition-jobs=2" \
+                                    "--trace=$TESTS/mixed.trace --tenants=8:24,8:24,16"; do
+                                bad=$("$PAGESIM" ALL 48 0 0 $opts --prefetch=$mode --prefetch-priority=$priority | awk -F', ' '
+                                        /^Prefetches: / {
+                                                for (i = 1; i <= NF; ++i) { split($i, f, ": "); v[f[1]] = f[2] }
+                                                if (v["Prefetches"] != v["Useful"] + v["Wasted"] + v["Unused"])
+                                                        print v["Prefetches"] " issued, " v["Useful"] " useful, " v["Wasted"] " wasted, " v["Unused"] " unused"
+                                                n++
+                                        }
+                                        END { if (n == 0) print "no prefetch stats" }
+                                ')
+                                if [ -n "$bad" ]; then
+                                        fail prefetch "$opts --prefetch=$mode --prefetch-priority=$priority: $(echo $bad)"
+                                        return
+                                fi
+                        done
+                done
+        done
+        pass prefetch
+}
+
+# The compressed pool never holds more bytes than its capacity, and its
+# bytes are the pages left in it (stored - loaded - written back) times
+# their compressed size. With every page compressing 2:1 that's exactly 2048
+# bytes a page, and the CPU and I/O times follow from the counts. A swap-in
+# reads a page that was rejected or written back earlier.
+check_zswap()
+{
+        for pool in 8192 20000 65536; do
+                for writeback in lru none; do
+                        for ratio in 2:2 1.5:4; do
+                                bad=$("$PAGESIM" ALL 32 0 0 --trace="$TESTS/mixed.trace" --zswap=$pool --zswap-writeback=$writeback \
+                                        --zswap-ratio=$ratio | awk -F', ' -v pool=$pool -v ratio=$ratio -v writeback=$writeback '
+                                        /^Zswap Stores: / || /^CPU us: / { for (i = 1; i <= NF; ++i) { split($i, f, ": "); v[f[1]] = f[2] } }
+                                        /^CPU us: / {
+                                                n++
+                                                pages = v["Zswap Stores"] - v["Loads"] - v["Writebacks"]
+                                                if (v["Pool Bytes"] > pool)
+                                                        print v["Pool Bytes"] " bytes in a pool of " pool
+                                                if (pages < 0 || v["Pool Bytes"] < pages*int(4096/4) || v["Pool Bytes"] > pages*int(4096/1.5))
+                                                        print v["Pool Bytes"] " bytes for " pages " pages"
+                                                if (v["Swap Ins"] > v["Rejects"] + v["Writebacks"])
+                                                        print v["Swap Ins"] " swap-ins of " v["Rejects"] + v["Writebacks"] " pages swapped"
+                                                if (writeback == "none" && v["Writebacks"] != 0)
+                                                        print v["Writebacks"] " writebacks with writeback off"
+                                                if (ratio == "2:2" && v["Pool Bytes"] != 2048*pages)
+                                                        print v["Pool Bytes"] " bytes for " pages " pages of 2048"
+                                                if (ratio == "2:2" && v["CPU us"] != 10*v["Zswap Stores"] + 3*v["Loads"])
+                                                        print v["CPU us"] " CPU us for " v["Zswap Stores"] " stores and " v["Loads"] " loads"
+                                                if (ratio == "2:2" && v["I/O us"] != 50*(v["Rejects"] + v["Writebacks"]) + 100*v["Swap Ins"])
+                                                        print v["I/O us"] " I/O us for " v["Rejects"] + v["Writebacks"] " writes and " v["Swap Ins"] " reads"
+                                        }
+                                        END { if (n == 0) print "no zswap stats" }
+                                ')
+                                if [ -n "$bad" ]; then
+                                        fail zswap "--zswap=$pool --zswap-writeback=$writeback --zswap-ratio=$ratio: $(echo $bad)"
+                                        return
+                                fi
+                        done
+                done
+        done
+        pass zswap
+}
+
+# Memory-time is the resident frames summed over every ref. With a metrics
+# window of one ref, each row's resident count must be the faults so far
+# less the evictions so far, within the frames, and the rows must add up to
+# the Memory-Time in the summary. WS and PFF release frames on their own,
+# so their resident sets shrink below the frames.
+check_memory_time()
+{
+        for opts in "--trace=$TESTS/mixed.trace --ws-window=10 --pff-threshold=5" "--trace=$TESTS/seq.trace" \
+                    "--trace=$TESTS/mixed.trace --ws-window=200 --pff-threshold=50"; do
+                "$PAGESIM" ALL 32 0 0 $opts --metrics="$TMP/metrics.csv" --metrics-window=1 > "$TMP/summary.out"
+                bad=$(awk -F', ' '
+                        FNR == NR {
+                                split($0, f, ",")
+                                if (f[1] == "ref") next
+                                misses[f[3]] += f[6]; evictions[f[3]] += f[9]
+                                if (f[10] != misses[f[3]] - evictions[f[3]] || f[10] > f[2])
+                                        print f[3] " at ref " f[1] " has " f[10] " resident"
+                                memtime[f[3]] += f[10]
+                                next
+                        }
+                        / Algorithm$/ { split($0, f, " "); algo = f[1] }
+                        /Memory-Time: / {
+                                split($2, f, ": ")
+                                if (f[2] != memtime[algo])
+                                        print algo " Memory-Time " f[2] ", resident summed over refs " memtime[algo] + 0
+                                checked++
+                        }
+                        END { if (checked == 0) print "no Memory-Time" }
+                ' "$TMP/metrics.csv" "$TMP/summary.out" | head -5)
+                if [ -n "$bad" ]; then
+                        fail memory_time "$opts: $(echo $bad)"
+                        return
+                fi
+        done
+        pass memory_time
+}
+
+# LECAR checks its own recency order, frequency buckets, free stack and
+# ghost rings at the end of a run. They must agree, with no more resident
+# pages or ghosts per expert than frames, after short and full runs, with
+# prefetching, and after forks that shrink and grow memory.
+check_lecar()
+{
+        for trace in seq mixed; do
+                for frames in 3 8 64; do
+                        : > "$TMP/lecar.out"
+                        for opts in "--refs=777" "" "--prefetch=cluster"; do
+                                "$PAGESIM" LECAR $frames 0 0 --trace="$TESTS/$trace.trace" $opts >> "$TMP/lecar.out"
+                        done
+                        "$PAGESIM" LECAR $frames 0 0 --trace="$TESTS/$trace.trace" --prefetch=seq --checkpoint="$TMP/ck" \
+                                --checkpoint-every=1000 >> "$TMP/lecar.out"
+                        "$PAGESIM" LECAR $frames 0 0 --trace="$TESTS/$trace.trace" --prefetch=seq --resume="$TMP/ck" \
+                                --fork=2,$frames,100 >> "$TMP/lecar.out"
+                        bad=$(awk -F', ' '
+                                /^Frames in Mem: / { split($1, f, ": "); frames = f[2] }
+                                /^LECAR State Inconsistent/ { print }
+                                /^LECAR State: / {
+                                        n++
+                                        split($1, f, " "); split($3, g, " "); split($4, h, " ")
+                                        if (f[4] > frames || g[3] > frames || h[2] > frames)
+                                                print $0 " with " frames " frames"
+                                }
+                                END { if (n != 7) print n " LECAR states printed, expected 7" }
+                        ' "$TMP/lecar.out")
+                        if [ -n "$bad" ]; then
+                                fail lecar "$trace.trace, $frames frames: $(echo $bad)"
+                                return
+                        fi
+                done
+        done
+        pass lecar
+}
+
+# --sample-check's full hit ratio must be the one a full run prints, its
+# error must be the estimate less that, and on the mixed trace every
+# estimate must be within 0.06 of the full run. A run that would cost as
+# much as a full one must be refused with exit status 1.
+check_sampling()
+{
+        "$PAGESIM" ALL 32 0 0 --trace="$TESTS/mixed.trace" > "$TMP/full.out"
+        for opts in "--sample=200 --sample-clusters=4 --sample-warmup=100" "--sample=250 --sample-clusters=6" \
+                    "--sample=100 --sample-clusters=8 --sample-warmup=200"; do
+                "$PAGESIM" ALL 32 0 0 --trace="$TESTS/mixed.trace" $opts --sample-check > "$TMP/sample.out"
+                bad=$(awk -F', ' '
+                        / Algorithm$/ { split($0, f, " "); algo = f[1] }
+                        FNR == NR && /Hit Ratio: / { split($4, f, ": "); full[algo] = f[2]; next }
+                        /Estimated Hit Ratio: / {
+                                n++
+                                split($2, e, ": "); split($3, f, ": "); split($4, d, ": ")
+                                if (f[2] != full[algo])
+                                        print algo " full hit ratio " f[2] ", a full run gives " full[algo]
+                                if (d[2] - (e[2] - f[2]) > 0.000002 || (e[2] - f[2]) - d[2] > 0.000002)
+                                        print algo " error " d[2] " for " e[2] " estimated and " f[2] " full"
+                                if (d[2] > 0.06 || d[2] < -0.06)
+                                        print algo " estimate " e[2] " off by " d[2]
+                        }
+                        END { if (n != 11) print n " estimates printed, expected 11" }
+                ' "$TMP/full.out" "$TMP/sample.out")
+                if [ -n "$bad" ]; then
+                        fail sampling "$opts: $(echo $bad)"
+                        return
+                fi
+        done
+        if "$PAGESIM" ALL 32 0 0 --trace="$TESTS/mixed.trace" --sample=1000 > /dev/null; then
+                fail sampling "a sample as costly as a full run wasn't refused"
+                return
+        fi
+        pass sampling
+}
+
+# Each algorithm's metrics windows must add up to its hits and misses in
+# the summary and cover every ref once, and the binary format must hold the
+# same rows as the CSV, across several blocks when windows are one ref.
+check_metrics()
+{
+        for window in 1 333 1000 5000; do
+                for opts in "--trace=$TESTS/mixed.trace" "--trace=$TESTS/seq.trace --prefetch=seq"; do
+                        "$PAGESIM" ALL 32 0 0 $opts --metrics="$TMP/metrics.csv" --metrics-window=$window > "$TMP/summary.out"
+                        "$PAGESIM" ALL 32 0 0 $opts --metrics="$TMP/metrics.bin" --metrics-window=$window --metrics-format=bin > /dev/null
+                        bad=$(awk -F', ' '
+                                FNR == NR {
+                                        split($0, f, ",")
+                                        if (f[1] == "ref") next
+                                        hits[f[3]] += f[5]; misses[f[3]] += f[6]; refs[f[3]] += f[4]
+                                        if (f[1] > last) last = f[1]
+                                        next
+                                }
+                                / Algorithm$/ { split($0, f, " "); algo = f[1] }
+                                /Hit Ratio: / {
+                                        n++
+                                        split($2, h, ": "); split($3, m, ": ")
+                                        if (h[2] != hits[algo] || m[2] != misses[algo])
+                                                print algo " windows sum to " hits[algo] + 0 " hits and " misses[algo] + 0 " misses"
+                                        if (refs[algo] != h[2] + m[2] || last != h[2] + m[2])
+                                                print algo " windows cover " refs[algo] + 0 " refs up to ref " last + 0
+                                }
+                                END { if (n == 0) print "no summary" }
+                        ' "$TMP/metrics.csv" "$TMP/summary.out")
+                        awk -F, '{ print $1 "," $2 "," $3 "," $4 "," $5 "," $6 "," $9 "," $10 }' "$TMP/metrics.csv" > "$TMP/metrics.rows"
+                        if [ "$(head -c 8 "$TMP/metrics.bin")" != PGSIMMT1 ]; then
+                                bad="$bad binary metrics without PGSIMMT1"
+                        elif ! od -An -v -t d4 -j 8 "$TMP/metrics.bin" | awk '
+                                BEGIN { split("OPTIMAL RANDOM FIFO LRU CLOCK NFU AGING WS WSCLOCK PFF LECAR", names, " ") }
+                                { for (i = 1; i <= NF; ++i) v[n++] = $i }
+                                END {
+                                        print "ref,frames,algorithm,refs,hits,misses,evictions,resident"
+                                        for (b = 0; b < n; b += 1 + 8*rows) {
+                                                rows = v[b]
+                                                for (r = 0; r < rows; ++r) {
+                                                        line = ""
+                                                        for (c = 0; c < 8; ++c) {
+                                                                x = v[b + 1 + c*rows + r]
+                                                                line = line (c ? "," : "") (c == 2 ? names[x + 1] : x)
+                                                        }
+                                                        print line
+                                                }
+                                        }
+                                }' | cmp -s - "$TMP/metrics.rows"; then
+                                bad="$bad binary metrics differ from CSV"
+                        fi
+                        if [ -n "$bad" ]; then
+                                fail metrics "$opts --metrics-window=$window: $(echo $bad)"
+                                return
+                        fi
+                done
+        done
+        pass metrics
+}
+
+check_belady
+check_prefetch
+check_zswap
+check_memory_time
+check_lecar
+check_sampling
+check_metrics
+check_tlb_walks
+check_sketches
+check_resume
+check_external
+check_partition_jobs
+
+exit $failed